@@ -0,0 +1,102 @@
+#include "aggregate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "parallel.h"
+
+namespace {
+// Below this many values per band, splitting a slice across threads costs
+// more than it saves.
+constexpr std::size_t kMinBandValues = 64 * 1024;
+}  // namespace
+
+std::optional<AggregateOp> parseAggregateOp(std::string_view name) {
+  for (auto op :
+       {AggregateOp::Mean, AggregateOp::Min, AggregateOp::Max,
+        AggregateOp::Sum}) {
+    if (name == aggregateOpName(op)) {
+      return op;
+    }
+  }
+  return std::nullopt;
+}
+
+std::string_view aggregateOpName(AggregateOp op) {
+  switch (op) {
+    case AggregateOp::Min:
+      return "min";
+    case AggregateOp::Max:
+      return "max";
+    case AggregateOp::Sum:
+      return "sum";
+    default:
+      return "mean";
+  }
+}
+
+std::vector<double> aggregate(Dataset const& dataset, std::size_t t0,
+                              std::size_t t1, std::size_t z_index,
+                              Window const& window, AggregateOp op,
+                              unsigned thread_count) {
+  auto size = window.y_count * window.x_count;
+  auto initial = 0.0;
+  if (op == AggregateOp::Min) {
+    initial = std::numeric_limits<double>::infinity();
+  } else if (op == AggregateOp::Max) {
+    initial = -std::numeric_limits<double>::infinity();
+  }
+  auto result = std::vector<double>(size, initial);
+  auto counts = std::vector<std::uint32_t>(size, 0);
+
+  // one band of rows per thread, unless that makes the bands too small
+  auto fill_value = dataset.fillValue();
+  auto min_band_rows = std::max<std::size_t>(
+      1, kMinBandValues / std::max<std::size_t>(1, window.x_count));
+  auto band_rows = std::max(
+      min_band_rows,
+      (window.y_count + thread_count - 1) / std::max(1u, thread_count));
+  auto band_count = (window.y_count + band_rows - 1) / band_rows;
+  parallelFor(band_count, thread_count, [&](std::size_t band) {
+    auto first_row = band * band_rows;
+    auto band_window = window;
+    band_window.y_start = window.y_start + first_row * window.stride;
+    band_window.y_count = std::min(band_rows, window.y_count - first_row);
+    auto* band_result = result.data() + first_row * window.x_count;
+    auto* band_counts = counts.data() + first_row * window.x_count;
+    auto band_size = band_window.y_count * window.x_count;
+    for (auto t_index = t0; t_index <= t1; ++t_index) {
+      // a long range would otherwise flush the slice cache
+      auto slice = band_window == dataset.fullWindow()
+                       ? std::make_shared<std::vector<double> const>(
+                             dataset.readSliceUncached(t_index, z_index))
+                       : dataset.readWindow(t_index, z_index, band_window);
+      auto const* values = slice->data();
+      for (std::size_t i = 0; i < band_size; ++i) {
+        auto value = values[i];
+        if (std::isnan(value) or value == fill_value) {
+          continue;
+        }
+        ++band_counts[i];
+        if (op == AggregateOp::Min) {
+          band_result[i] = std::min(band_result[i], value);
+        } else if (op == AggregateOp::Max) {
+          band_result[i] = std::max(band_result[i], value);
+        } else {
+          band_result[i] += value;
+        }
+      }
+    }
+
+    for (std::size_t i = 0; i < band_size; ++i) {
+      if (band_counts[i] == 0) {
+        band_result[i] = std::numeric_limits<double>::quiet_NaN();
+      } else if (op == AggregateOp::Mean) {
+        band_result[i] /= band_counts[i];
+      }
+    }
+  });
+  return result;
+}
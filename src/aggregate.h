@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "dataset.h"
+
+enum class AggregateOp { Mean, Min, Max, Sum };
+
+// Parses "mean", "min", "max" or "sum"; returns std::nullopt for anything
+// else.
+std::optional<AggregateOp> parseAggregateOp(std::string_view name);
+std::string_view aggregateOpName(AggregateOp op);
+
+// Reduces a window over the time steps t0 to t1 (inclusive) at one z level,
+// cell by cell, into one row-major field. The window is split into bands of
+// rows, one per thread on up to thread_count threads, and each thread reads
+// and folds its band of every time step in turn. Reads are serialized, so
+// one thread reads while the others fold, and memory stays at about one
+// window however long the range is.
+// Missing values (NaN or the fill value) are skipped; a cell with no values
+// at all is NaN. Indices and window are not bounds checked.
+std::vector<double> aggregate(Dataset const& dataset, std::size_t t0,
+                              std::size_t t1, std::size_t z_index,
+                              Window const& window, AggregateOp op,
+                              unsigned thread_count);
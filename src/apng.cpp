@@ -0,0 +1,114 @@
+#include "apng.h"
+
+#include <zlib.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+constexpr std::string_view kPngSignature{"\x89PNG\r\n\x1a\n", 8};
+
+struct Chunk {
+  std::string_view type;
+  std::string_view data;
+};
+
+std::uint32_t readBigEndian(std::string_view bytes) {
+  return static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[0]))
+             << 24 |
+         static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[1]))
+             << 16 |
+         static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[2]))
+             << 8 |
+         static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[3]));
+}
+
+void appendBigEndian(std::string& out, std::uint32_t value, int size = 4) {
+  for (auto shift = 8 * (size - 1); shift >= 0; shift -= 8) {
+    out += static_cast<char>((value >> shift) & 0xFF);
+  }
+}
+
+// Splits a PNG file into its chunks; CRCs are not checked.
+std::vector<Chunk> readChunks(std::string_view png) {
+  if (png.substr(0, kPngSignature.size()) != kPngSignature) {
+    throw std::invalid_argument("Frame is not a PNG file.");
+  }
+  png.remove_prefix(kPngSignature.size());
+  auto chunks = std::vector<Chunk>{};
+  while (png.size() >= 12) {
+    auto length = readBigEndian(png);
+    if (length > png.size() - 12) {
+      break;
+    }
+    chunks.push_back({png.substr(4, 4), png.substr(8, length)});
+    png.remove_prefix(12 + length);
+  }
+  if (chunks.empty() or chunks.front().type != "IHDR") {
+    throw std::invalid_argument("Frame is not a PNG file.");
+  }
+  return chunks;
+}
+
+// Appends a chunk whose data is prefix followed by data.
+void appendChunk(std::string& out, std::string_view type,
+                 std::string_view prefix, std::string_view data) {
+  appendBigEndian(out, static_cast<std::uint32_t>(prefix.size() + data.size()));
+  auto start = out.size();
+  out += type;
+  out += prefix;
+  out += data;
+  auto crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, reinterpret_cast<Bytef const*>(out.data() + start),
+              static_cast<uInt>(out.size() - start));
+  appendBigEndian(out, static_cast<std::uint32_t>(crc));
+}
+}  // namespace
+
+std::string assembleApng(std::vector<std::string> const& frames,
+                         unsigned delay_ms) {
+  if (frames.empty()) {
+    throw std::invalid_argument("An animation needs at least one frame.");
+  }
+  auto first = readChunks(frames.front());
+  auto const& header = first.front().data;
+
+  auto out = std::string{kPngSignature};
+  appendChunk(out, "IHDR", {}, header);
+  auto animation_control = std::string{};
+  appendBigEndian(animation_control, static_cast<std::uint32_t>(frames.size()));
+  appendBigEndian(animation_control, 0);  // loop forever
+  appendChunk(out, "acTL", {}, animation_control);
+
+  // frame control and frame data chunks share one sequence
+  std::uint32_t sequence = 0;
+  for (std::size_t i = 0; i < frames.size(); ++i) {
+    auto chunks = i == 0 ? first : readChunks(frames[i]);
+    auto frame_control = std::string{};
+    appendBigEndian(frame_control, sequence++);
+    frame_control += header.substr(0, 8);  // width and height
+    appendBigEndian(frame_control, 0);     // x offset
+    appendBigEndian(frame_control, 0);     // y offset
+    appendBigEndian(frame_control, delay_ms, 2);
+    appendBigEndian(frame_control, 1000, 2);  // delay in milliseconds
+    frame_control += '\0';                    // no disposal
+    frame_control += '\0';                    // replace the previous frame
+    appendChunk(out, "fcTL", {}, frame_control);
+
+    for (auto const& chunk : chunks) {
+      if (chunk.type != "IDAT") {
+        continue;
+      }
+      if (i == 0) {
+        appendChunk(out, "IDAT", {}, chunk.data);
+      } else {
+        auto number = std::string{};
+        appendBigEndian(number, sequence++);
+        appendChunk(out, "fdAT", number, chunk.data);
+      }
+    }
+  }
+  appendChunk(out, "IEND", {}, {});
+  return out;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Assembles PNG files of equal size and color type, such as those written by
+// encodePng, into one animated PNG that shows each frame for delay_ms
+// milliseconds (at most 65535) and loops forever. The first frame doubles as
+// the still image shown by decoders without APNG support. Throws
+// std::invalid_argument if there are no frames or a frame is not a PNG.
+std::string assembleApng(std::vector<std::string> const& frames,
+                         unsigned delay_ms);
@@ -0,0 +1,254 @@
+#include "arrow_ipc.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace {
+// values from the Arrow format definitions (Schema.fbs and Message.fbs)
+constexpr std::int16_t kMetadataVersionV5 = 4;
+constexpr std::uint8_t kMessageHeaderSchema = 1;
+constexpr std::uint8_t kMessageHeaderRecordBatch = 3;
+constexpr std::uint8_t kTypeFloatingPoint = 3;
+constexpr std::int16_t kPrecisionSingle = 1;
+constexpr std::int16_t kPrecisionDouble = 2;
+constexpr std::uint32_t kContinuationMarker = 0xFFFFFFFF;
+
+std::size_t alignUp(std::size_t value, std::size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Writes the low `size` bytes of value at pos in little-endian order.
+void putUnsigned(std::string& buffer, std::size_t pos, std::uint64_t value,
+                 std::size_t size) {
+  for (std::size_t i = 0; i < size; ++i) {
+    buffer[pos + i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+  }
+}
+
+void appendUnsigned(std::string& buffer, std::uint64_t value,
+                    std::size_t size) {
+  auto pos = buffer.size();
+  buffer.append(size, '\0');
+  putUnsigned(buffer, pos, value, size);
+}
+
+// Minimal FlatBuffers encoder for the few Arrow metadata tables we emit. The
+// buffer is built front to back: offsets in FlatBuffers must point forward, so
+// a table is written before the objects it references and its offset fields
+// are patched once those objects exist.
+class FlatBufferWriter {
+ public:
+  struct Field {
+    int id;
+    std::size_t size;  // inline size in bytes; 4 for offset fields
+    std::uint64_t value = 0;
+    bool is_offset = false;
+  };
+  static Field scalar(int id, std::size_t size, std::uint64_t value) {
+    return {id, size, value, false};
+  }
+  static Field offset(int id) { return {id, 4, 0, true}; }
+
+  // reserve the root offset
+  FlatBufferWriter() { buffer_.append(4, '\0'); }
+
+  // Writes a vtable followed by its table. Returns the table position and the
+  // position of every field, in the order given, for patching offsets.
+  std::pair<std::size_t, std::vector<std::size_t>> table(
+      std::vector<Field> const& fields) {
+    // lay out inline fields largest first, so each one is naturally aligned
+    auto order = std::vector<std::size_t>(fields.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](auto a, auto b) {
+      return fields[a].size > fields[b].size;
+    });
+    auto field_offsets = std::vector<std::size_t>(fields.size());
+    std::size_t table_size = 4;  // soffset to the vtable
+    for (auto i : order) {
+      table_size = alignUp(table_size, fields[i].size);
+      field_offsets[i] = table_size;
+      table_size += fields[i].size;
+    }
+
+    auto max_id = -1;
+    for (auto const& field : fields) {
+      max_id = std::max(max_id, field.id);
+    }
+    auto slots = std::vector<std::uint16_t>(max_id + 1, 0);
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+      slots[fields[i].id] = static_cast<std::uint16_t>(field_offsets[i]);
+    }
+
+    align(2);
+    auto vtable_pos = buffer_.size();
+    appendUnsigned(buffer_, 4 + 2 * slots.size(), 2);
+    appendUnsigned(buffer_, table_size, 2);
+    for (auto slot : slots) {
+      appendUnsigned(buffer_, slot, 2);
+    }
+
+    align(8);
+    auto table_pos = buffer_.size();
+    buffer_.append(table_size, '\0');
+    putUnsigned(buffer_, table_pos, table_pos - vtable_pos, 4);
+    auto positions = std::vector<std::size_t>(fields.size());
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+      positions[i] = table_pos + field_offsets[i];
+      if (not fields[i].is_offset) {
+        putUnsigned(buffer_, positions[i], fields[i].value, fields[i].size);
+      }
+    }
+    return {table_pos, positions};
+  }
+
+  // Writes a vector of `count` offsets to be patched. Element i lives at the
+  // returned position + 4 + 4 * i.
+  std::size_t offsetVector(std::size_t count) {
+    align(4);
+    auto pos = buffer_.size();
+    appendUnsigned(buffer_, count, 4);
+    buffer_.append(4 * count, '\0');
+    return pos;
+  }
+
+  // Writes a vector of structs made of 8-byte fields.
+  std::size_t structVector(std::vector<std::uint64_t> const& words,
+                           std::size_t words_per_struct) {
+    // the elements, not the length prefix, must be 8-byte aligned
+    while ((buffer_.size() + 4) % 8 != 0) {
+      buffer_ += '\0';
+    }
+    auto pos = buffer_.size();
+    appendUnsigned(buffer_, words.size() / words_per_struct, 4);
+    for (auto word : words) {
+      appendUnsigned(buffer_, word, 8);
+    }
+    return pos;
+  }
+
+  std::size_t string(std::string_view text) {
+    align(4);
+    auto pos = buffer_.size();
+    appendUnsigned(buffer_, text.size(), 4);
+    buffer_ += text;
+    buffer_ += '\0';
+    return pos;
+  }
+
+  void patch(std::size_t slot, std::size_t target) {
+    putUnsigned(buffer_, slot, target - slot, 4);
+  }
+
+  // Sets the root table and returns the buffer padded to 8 bytes.
+  std::string finish(std::size_t root_table) {
+    patch(0, root_table);
+    align(8);
+    return std::move(buffer_);
+  }
+
+ private:
+  void align(std::size_t alignment) {
+    buffer_.append(alignUp(buffer_.size(), alignment) - buffer_.size(), '\0');
+  }
+
+  std::string buffer_;
+};
+
+using F = FlatBufferWriter;
+
+// Writes the Message table wrapping a header table; returns the position of
+// the header offset slot.
+std::pair<std::size_t, std::size_t> messageTable(FlatBufferWriter& writer,
+                                                 std::uint8_t header_type,
+                                                 std::size_t body_length) {
+  auto [message, slots] =
+      writer.table({F::scalar(0, 2, kMetadataVersionV5),
+                     F::scalar(1, 1, header_type), F::offset(2),
+                     F::scalar(3, 8, body_length)});
+  return {message, slots[2]};
+}
+
+std::string schemaMessage(std::vector<ArrowColumn> const& columns) {
+  auto writer = FlatBufferWriter{};
+  auto [message, header_slot] =
+      messageTable(writer, kMessageHeaderSchema, 0);
+
+  auto [schema, schema_slots] =
+      writer.table({F::scalar(0, 2, 0 /* little endian */), F::offset(1)});
+  writer.patch(header_slot, schema);
+
+  auto fields = writer.offsetVector(columns.size());
+  writer.patch(schema_slots[1], fields);
+  for (std::size_t i = 0; i < columns.size(); ++i) {
+    auto [field, field_slots] = writer.table(
+        {F::offset(0), F::scalar(1, 1, 0 /* not nullable */),
+         F::scalar(2, 1, kTypeFloatingPoint), F::offset(3), F::offset(5)});
+    writer.patch(fields + 4 + 4 * i, field);
+    writer.patch(field_slots[0], writer.string(columns[i].name));
+    auto precision = columns[i].dtype == DType::Float32 ? kPrecisionSingle
+                                                        : kPrecisionDouble;
+    auto [type, type_slots] = writer.table({F::scalar(0, 2, precision)});
+    writer.patch(field_slots[3], type);
+    writer.patch(field_slots[4], writer.offsetVector(0));
+  }
+  return writer.finish(message);
+}
+
+std::string recordBatchMessage(std::vector<ArrowColumn> const& columns,
+                               std::size_t length, std::size_t body_length) {
+  auto writer = FlatBufferWriter{};
+  auto [message, header_slot] =
+      messageTable(writer, kMessageHeaderRecordBatch, body_length);
+
+  auto [batch, batch_slots] =
+      writer.table({F::scalar(0, 8, length), F::offset(1), F::offset(2)});
+  writer.patch(header_slot, batch);
+
+  // one FieldNode {length, null_count} and two Buffers {offset, length}
+  // (validity bitmap, values) per column
+  auto nodes = std::vector<std::uint64_t>{};
+  auto buffers = std::vector<std::uint64_t>{};
+  std::size_t body_offset = 0;
+  for (auto const& column : columns) {
+    nodes.insert(nodes.end(), {length, 0});
+    auto data_length = length * dtypeSize(column.dtype);
+    buffers.insert(buffers.end(), {body_offset, 0, body_offset, data_length});
+    body_offset += alignUp(data_length, 8);
+  }
+  writer.patch(batch_slots[1], writer.structVector(nodes, 2));
+  writer.patch(batch_slots[2], writer.structVector(buffers, 2));
+  return writer.finish(message);
+}
+
+void appendMessage(std::string const& metadata, std::string& out) {
+  appendUnsigned(out, kContinuationMarker, 4);
+  appendUnsigned(out, metadata.size(), 4);
+  out += metadata;
+}
+}  // namespace
+
+void appendArrowStream(std::vector<ArrowColumn> const& columns,
+                       std::string& out) {
+  auto length = columns.empty() ? 0 : columns.front().values->size();
+  std::size_t body_length = 0;
+  for (auto const& column : columns) {
+    body_length += alignUp(length * dtypeSize(column.dtype), 8);
+  }
+
+  appendMessage(schemaMessage(columns), out);
+  appendMessage(recordBatchMessage(columns, length, body_length), out);
+  out.reserve(out.size() + body_length + 8);
+  for (auto const& column : columns) {
+    auto start = out.size();
+    appendLittleEndian(*column.values, column.dtype, out);
+    out.append(alignUp(out.size() - start, 8) - (out.size() - start), '\0');
+  }
+
+  // end-of-stream marker
+  appendUnsigned(out, kContinuationMarker, 4);
+  appendUnsigned(out, 0, 4);
+}
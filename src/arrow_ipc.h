@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "binary_formats.h"
+
+// A named column of numbers for an Arrow record batch. Columns are encoded as
+// non-nullable floating point arrays of the given type.
+struct ArrowColumn {
+  std::string name;
+  std::vector<double> const* values;
+  DType dtype;
+};
+
+// Appends a complete Arrow IPC stream (schema message, one record batch and
+// the end-of-stream marker) to out. All columns must have the same length. The
+// stream can be read with e.g. pyarrow.ipc.open_stream.
+void appendArrowStream(std::vector<ArrowColumn> const& columns,
+                       std::string& out);
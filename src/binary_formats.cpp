@@ -0,0 +1,101 @@
+#include "binary_formats.h"
+
+#include <cstring>
+#include <utility>
+
+namespace {
+constexpr bool kHostIsLittleEndian =
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+
+// Appends the bytes of each element in little-endian order.
+template <typename T>
+void appendElements(double const* values, std::size_t size,
+                    std::string& out) {
+  auto offset = out.size();
+  out.resize(offset + size * sizeof(T));
+  auto* dest = out.data() + offset;
+  for (std::size_t i = 0; i < size; ++i) {
+    auto element = static_cast<T>(values[i]);
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &element, sizeof(T));
+    if constexpr (not kHostIsLittleEndian) {
+      for (std::size_t i = 0; i < sizeof(T) / 2; ++i) {
+        std::swap(bytes[i], bytes[sizeof(T) - 1 - i]);
+      }
+    }
+    std::memcpy(dest, bytes, sizeof(T));
+    dest += sizeof(T);
+  }
+}
+}  // namespace
+
+std::optional<DType> parseDType(std::string_view name) {
+  if (name == "float32") {
+    return DType::Float32;
+  }
+  if (name == "float64") {
+    return DType::Float64;
+  }
+  return std::nullopt;
+}
+
+std::string_view dtypeName(DType dtype) {
+  return dtype == DType::Float32 ? "float32" : "float64";
+}
+
+std::size_t dtypeSize(DType dtype) {
+  return dtype == DType::Float32 ? sizeof(float) : sizeof(double);
+}
+
+void appendLittleEndian(std::vector<double> const& values, DType dtype,
+                        std::string& out) {
+  appendLittleEndian(values.data(), values.size(), dtype, out);
+}
+
+void appendLittleEndian(double const* values, std::size_t size, DType dtype,
+                        std::string& out) {
+  if (dtype == DType::Float64 and kHostIsLittleEndian) {
+    // already in the wire format
+    out.append(reinterpret_cast<char const*>(values), size * sizeof(double));
+  } else if (dtype == DType::Float64) {
+    appendElements<double>(values, size, out);
+  } else {
+    appendElements<float>(values, size, out);
+  }
+}
+
+void appendNpyHeader(std::vector<std::size_t> const& shape, DType dtype,
+                     std::string& out) {
+  auto header = std::string{"{'descr': '"};
+  header += dtype == DType::Float32 ? "<f4" : "<f8";
+  header += "', 'fortran_order': False, 'shape': (";
+  for (std::size_t i = 0; i < shape.size(); ++i) {
+    header += (i > 0 ? ", " : "") + std::to_string(shape[i]);
+  }
+  if (shape.size() == 1) {
+    header += ',';  // Python tuple syntax for one element
+  }
+  header += "), }";
+
+  // magic, version and header length take 10 bytes; the header is padded
+  // with spaces and a newline so the data starts on a 64-byte boundary
+  constexpr std::size_t kPreambleSize = 10;
+  auto padded_size =
+      (kPreambleSize + header.size() + 1 + 63) / 64 * 64 - kPreambleSize;
+  header.append(padded_size - header.size() - 1, ' ');
+  header += '\n';
+
+  out += "\x93NUMPY";
+  out += '\x01';
+  out += '\x00';
+  out += static_cast<char>(header.size() & 0xFF);
+  out += static_cast<char>((header.size() >> 8) & 0xFF);
+  out += header;
+}
+
+void appendNpy(std::vector<double> const& values,
+               std::vector<std::size_t> const& shape, DType dtype,
+               std::string& out) {
+  appendNpyHeader(shape, dtype, out);
+  appendLittleEndian(values, dtype, out);
+}
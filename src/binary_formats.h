@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Element type of a binary encoded array. Values are always read as double and
+// are downcast on output when float32 is requested.
+enum class DType { Float32, Float64 };
+
+// Parses "float32" or "float64"; returns std::nullopt for anything else.
+std::optional<DType> parseDType(std::string_view name);
+std::string_view dtypeName(DType dtype);
+std::size_t dtypeSize(DType dtype);
+
+// Appends values to out as contiguous little-endian numbers of the given type.
+void appendLittleEndian(std::vector<double> const& values, DType dtype,
+                        std::string& out);
+void appendLittleEndian(double const* values, std::size_t size, DType dtype,
+                        std::string& out);
+
+// Appends the header of a NumPy .npy (format version 1.0) file for a C-ordered
+// array of the given shape; the data follows as appendLittleEndian writes it.
+void appendNpyHeader(std::vector<std::size_t> const& shape, DType dtype,
+                     std::string& out);
+
+// Appends a NumPy .npy (format version 1.0) file holding values as a
+// C-ordered array of the given shape.
+void appendNpy(std::vector<double> const& values,
+               std::vector<std::size_t> const& shape, DType dtype,
+               std::string& out);
@@ -0,0 +1,110 @@
+#include "colormap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace {
+using Rgb = std::array<double, 3>;
+
+// Nine evenly spaced control points, every 255/8 = 31.875 levels from 0 to
+// 255. Viridis and magma are sampled from the matplotlib definitions;
+// diverging is the ColorBrewer RdBu scheme running from blue to red.
+constexpr std::array<Rgb, 9> kViridis{{{0.267004, 0.004874, 0.329415},
+                                       {0.282623, 0.140926, 0.457517},
+                                       {0.229739, 0.322361, 0.545706},
+                                       {0.172719, 0.448791, 0.557885},
+                                       {0.127568, 0.566949, 0.550556},
+                                       {0.134692, 0.658636, 0.517649},
+                                       {0.288921, 0.758394, 0.428426},
+                                       {0.626579, 0.854645, 0.223353},
+                                       {0.993248, 0.906157, 0.143936}}};
+constexpr std::array<Rgb, 9> kMagma{{{0.001462, 0.000466, 0.013866},
+                                     {0.113094, 0.065492, 0.276784},
+                                     {0.316654, 0.071690, 0.485380},
+                                     {0.512831, 0.148179, 0.507648},
+                                     {0.716387, 0.214982, 0.475290},
+                                     {0.904281, 0.319610, 0.388137},
+                                     {0.992440, 0.520837, 0.362510},
+                                     {0.996341, 0.762373, 0.524606},
+                                     {0.987053, 0.991438, 0.749504}}};
+constexpr std::array<Rgb, 9> kDiverging{{{0x21, 0x66, 0xac},
+                                         {0x43, 0x93, 0xc3},
+                                         {0x92, 0xc5, 0xde},
+                                         {0xd1, 0xe5, 0xf0},
+                                         {0xf7, 0xf7, 0xf7},
+                                         {0xfd, 0xdb, 0xc7},
+                                         {0xf4, 0xa5, 0x82},
+                                         {0xd6, 0x60, 0x4d},
+                                         {0xb2, 0x18, 0x2b}}};
+
+// Linearly interpolates the control points, given on a 0-1 (or, with
+// max_component 255, a 0-255) scale, into a full table.
+ColormapLut interpolate(std::array<Rgb, 9> const& points,
+                        double max_component) {
+  auto lut = ColormapLut{};
+  for (std::size_t level = 0; level < lut.size(); ++level) {
+    auto position = level * (points.size() - 1) / 255.0;
+    auto index = std::min(static_cast<std::size_t>(position),
+                          points.size() - 2);
+    auto fraction = position - index;
+    for (std::size_t channel = 0; channel < 3; ++channel) {
+      auto value = points[index][channel] +
+                   fraction * (points[index + 1][channel] -
+                               points[index][channel]);
+      lut[level][channel] =
+          static_cast<std::uint8_t>(std::lround(value / max_component * 255));
+    }
+  }
+  return lut;
+}
+
+ColormapLut grayLut() {
+  auto lut = ColormapLut{};
+  for (std::size_t level = 0; level < lut.size(); ++level) {
+    auto gray = static_cast<std::uint8_t>(level);
+    lut[level] = {gray, gray, gray};
+  }
+  return lut;
+}
+}  // namespace
+
+std::optional<Colormap> parseColormap(std::string_view name) {
+  for (auto colormap : {Colormap::Gray, Colormap::Viridis, Colormap::Magma,
+                        Colormap::Diverging}) {
+    if (name == colormapName(colormap)) {
+      return colormap;
+    }
+  }
+  return std::nullopt;
+}
+
+std::string_view colormapName(Colormap colormap) {
+  switch (colormap) {
+    case Colormap::Viridis:
+      return "viridis";
+    case Colormap::Magma:
+      return "magma";
+    case Colormap::Diverging:
+      return "diverging";
+    default:
+      return "gray";
+  }
+}
+
+ColormapLut const& colormapLut(Colormap colormap) {
+  static auto const gray = grayLut();
+  static auto const viridis = interpolate(kViridis, 1.0);
+  static auto const magma = interpolate(kMagma, 1.0);
+  static auto const diverging = interpolate(kDiverging, 255.0);
+  switch (colormap) {
+    case Colormap::Viridis:
+      return viridis;
+    case Colormap::Magma:
+      return magma;
+    case Colormap::Diverging:
+      return diverging;
+    default:
+      return gray;
+  }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Color scales for rendered images. Gray renders single-channel PNGs; the
+// others map each quantized level through a 256-entry RGB lookup table.
+enum class Colormap { Gray, Viridis, Magma, Diverging };
+
+using ColormapLut = std::array<std::array<std::uint8_t, 3>, 256>;
+
+// Parses "gray", "viridis", "magma" or "diverging"; returns std::nullopt for
+// anything else.
+std::optional<Colormap> parseColormap(std::string_view name);
+std::string_view colormapName(Colormap colormap);
+
+// The lookup table for a colormap, built on first use.
+ColormapLut const& colormapLut(Colormap colormap);
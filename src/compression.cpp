@@ -0,0 +1,200 @@
+#include "compression.h"
+
+#include <crow/http_response.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace {
+constexpr std::size_t kChunkSize = 64 * 1024;
+
+// zlib window bits selecting the gzip (RFC 1952) or zlib (RFC 1950) wrapper;
+// the latter is what HTTP calls "deflate"
+int windowBits(ContentEncoding encoding) {
+  return encoding == ContentEncoding::Gzip ? 15 + 16 : 15;
+}
+
+void initStream(z_stream& stream, ContentEncoding encoding, int level) {
+  if (deflateInit2(&stream, level, Z_DEFLATED, windowBits(encoding), 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::runtime_error("Failed to initialize compressor.");
+  }
+}
+
+// Feeds input to the stream, appending all produced output to out. With
+// Z_FINISH the stream is completed.
+void deflateInto(z_stream& stream, std::string_view input, int flush_mode,
+                 std::string& out) {
+  do {
+    // zlib counts in uInt, so feed large inputs in pieces
+    auto piece = std::min(input.size(), kChunkSize * 16);
+    stream.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(piece);
+    input.remove_prefix(piece);
+    auto mode = input.empty() ? flush_mode : Z_NO_FLUSH;
+
+    auto status = Z_OK;
+    do {
+      auto used = out.size();
+      out.resize(used + kChunkSize);
+      stream.next_out = reinterpret_cast<Bytef*>(out.data() + used);
+      stream.avail_out = static_cast<uInt>(kChunkSize);
+      status = deflate(&stream, mode);
+      out.resize(used + kChunkSize - stream.avail_out);
+    } while (mode == Z_FINISH ? status != Z_STREAM_END
+                              : stream.avail_out == 0);
+  } while (not input.empty());
+}
+}  // namespace
+
+ContentEncoding negotiateEncoding(std::string_view accept_encoding) {
+  auto accepts_gzip = false;
+  auto accepts_deflate = false;
+  while (not accept_encoding.empty()) {
+    auto end = std::min(accept_encoding.find(','), accept_encoding.size());
+    auto coding = accept_encoding.substr(0, end);
+    accept_encoding.remove_prefix(std::min(end + 1, accept_encoding.size()));
+
+    // split off parameters; q=0 marks a coding as not acceptable
+    auto refused = false;
+    if (auto semicolon = coding.find(';');
+        semicolon != std::string_view::npos) {
+      auto params = std::string{coding.substr(semicolon + 1)};
+      coding = coding.substr(0, semicolon);
+      if (auto q = params.find("q="); q != std::string::npos) {
+        refused = std::strtod(params.c_str() + q + 2, nullptr) <= 0.0;
+      }
+    }
+    if (refused) {
+      continue;
+    }
+
+    auto name = std::string{};
+    for (auto c : coding) {
+      if (not std::isspace(static_cast<unsigned char>(c))) {
+        name += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+      }
+    }
+    if (name == "gzip" or name == "x-gzip" or name == "*") {
+      accepts_gzip = true;
+    } else if (name == "deflate") {
+      accepts_deflate = true;
+    }
+  }
+  if (accepts_gzip) {
+    return ContentEncoding::Gzip;
+  }
+  return accepts_deflate ? ContentEncoding::Deflate : ContentEncoding::Identity;
+}
+
+std::string_view encodingName(ContentEncoding encoding) {
+  switch (encoding) {
+    case ContentEncoding::Gzip:
+      return "gzip";
+    case ContentEncoding::Deflate:
+      return "deflate";
+    default:
+      return "";
+  }
+}
+
+std::string compress(std::string_view data, ContentEncoding encoding,
+                     int level) {
+  auto stream = z_stream{};
+  initStream(stream, encoding, level);
+  auto out = std::string{};
+  out.reserve(deflateBound(&stream, data.size()));
+  deflateInto(stream, data, Z_FINISH, out);
+  deflateEnd(&stream);
+  return out;
+}
+
+PrecompressedBody::PrecompressedBody(std::string body,
+                                     CompressionOptions const& options)
+    : compressed_{options.level > 0}, identity_{std::move(body)} {
+  if (compressed_ and identity_.size() >= options.min_size) {
+    gzip_ = compress(identity_, ContentEncoding::Gzip, options.level);
+    deflate_ = compress(identity_, ContentEncoding::Deflate, options.level);
+  }
+}
+
+ContentEncoding PrecompressedBody::variant(ContentEncoding encoding) const {
+  if ((encoding == ContentEncoding::Gzip and not gzip_.empty()) or
+      (encoding == ContentEncoding::Deflate and not deflate_.empty())) {
+    return encoding;
+  }
+  return ContentEncoding::Identity;
+}
+
+void PrecompressedBody::setVary(crow::response& response) const {
+  if (compressed_) {
+    response.set_header("Vary", "Accept-Encoding");
+  }
+}
+
+void PrecompressedBody::finish(ContentEncoding encoding,
+                               crow::response& response) const {
+  setVary(response);
+  switch (variant(encoding)) {
+    case ContentEncoding::Gzip:
+      response.body = gzip_;
+      break;
+    case ContentEncoding::Deflate:
+      response.body = deflate_;
+      break;
+    default:
+      response.body = identity_;
+      return;
+  }
+  response.set_header("Content-Encoding",
+                      std::string{encodingName(encoding)});
+}
+
+ResponseBody::ResponseBody(ContentEncoding encoding,
+                           CompressionOptions const& options)
+    : encoding_{options.level > 0 ? encoding : ContentEncoding::Identity},
+      options_{options} {}
+
+ResponseBody::~ResponseBody() {
+  if (started_) {
+    deflateEnd(&stream_);
+  }
+}
+
+void ResponseBody::flush() {
+  if (encoding_ == ContentEncoding::Identity or staged_.size() < kChunkSize) {
+    return;
+  }
+  // hold off until the body is known to be worth compressing
+  if (not started_ and staged_.size() < options_.min_size) {
+    return;
+  }
+  deflateStaged(Z_NO_FLUSH);
+}
+
+void ResponseBody::finish(crow::response& response) {
+  if (options_.level > 0) {
+    response.set_header("Vary", "Accept-Encoding");
+  }
+  if (encoding_ == ContentEncoding::Identity or
+      (not started_ and staged_.size() < options_.min_size)) {
+    response.body = std::move(staged_);
+    return;
+  }
+  deflateStaged(Z_FINISH);
+  response.body = std::move(compressed_);
+  response.set_header("Content-Encoding",
+                      std::string{encodingName(encoding_)});
+}
+
+void ResponseBody::deflateStaged(int flush_mode) {
+  if (not started_) {
+    initStream(stream_, encoding_, options_.level);
+    started_ = true;
+  }
+  deflateInto(stream_, staged_, flush_mode, compressed_);
+  staged_.clear();
+}
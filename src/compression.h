@@ -0,0 +1,93 @@
+#pragma once
+
+#include <zlib.h>
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace crow {
+struct response;
+}
+
+enum class ContentEncoding { Identity, Gzip, Deflate };
+
+struct CompressionOptions {
+  // zlib compression level from 1 (fastest) to 9 (smallest); 0 disables
+  // compression altogether
+  int level = 6;
+  // bodies smaller than this are sent uncompressed
+  std::size_t min_size = 1024;
+};
+
+// Picks the preferred encoding accepted by an Accept-Encoding header value,
+// preferring gzip over deflate. Codings with q=0 are treated as refused.
+ContentEncoding negotiateEncoding(std::string_view accept_encoding);
+
+// Content-Encoding header value for an encoding ("" for identity).
+std::string_view encodingName(ContentEncoding encoding);
+
+// Compresses data in one go.
+std::string compress(std::string_view data, ContentEncoding encoding,
+                     int level);
+
+// A body that never changes, compressed up front in every encoding we serve
+// so requests only have to pick the right copy.
+class PrecompressedBody {
+ public:
+  PrecompressedBody(std::string body, CompressionOptions const& options);
+
+  std::string const& identity() const { return identity_; }
+
+  // The encoding of the variant sent for an accepted encoding. Small bodies
+  // have no compressed variants and are always sent as they are.
+  ContentEncoding variant(ContentEncoding encoding) const;
+
+  // Sets the Vary header if the body is sent differently depending on the
+  // accepted encoding. finish() does this too; responses without a body,
+  // such as 304, need it on their own.
+  void setVary(crow::response& response) const;
+
+  // Copies the variant for the accepted encoding into the response and sets
+  // the Content-Encoding and Vary headers as appropriate.
+  void finish(ContentEncoding encoding, crow::response& response) const;
+
+ private:
+  bool compressed_ = false;
+  std::string identity_;
+  std::string gzip_;
+  std::string deflate_;
+};
+
+// Builds a response body that is compressed while it is being produced.
+// Callers append text to text() and call flush() at convenient points; once
+// enough text has accumulated it is fed to the compressor and discarded, so
+// the plain and compressed forms of a large body are never held in full at
+// the same time. Bodies that end up smaller than the minimum size are sent
+// uncompressed.
+class ResponseBody {
+ public:
+  ResponseBody(ContentEncoding encoding, CompressionOptions const& options);
+  ~ResponseBody();
+  ResponseBody(ResponseBody const&) = delete;
+  ResponseBody& operator=(ResponseBody const&) = delete;
+
+  std::string& text() { return staged_; }
+
+  // Compresses the staged text if there is enough of it to be worthwhile.
+  void flush();
+
+  // Moves the finished body into the response and sets the Content-Encoding
+  // and Vary headers as appropriate.
+  void finish(crow::response& response);
+
+ private:
+  void deflateStaged(int flush_mode);
+
+  ContentEncoding encoding_;
+  CompressionOptions options_;
+  z_stream stream_{};
+  bool started_ = false;
+  std::string staged_;
+  std::string compressed_;
+};
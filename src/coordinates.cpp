@@ -0,0 +1,47 @@
+#include "coordinates.h"
+
+#include <algorithm>
+#include <functional>
+
+std::pair<std::size_t, std::size_t> coordinateRange(
+    std::vector<double> const& values, double low, double high) {
+  if (values.empty() or low > high) {
+    return {0, 0};
+  }
+  auto begin = values.begin();
+  auto end = values.end();
+  if (values.front() <= values.back()) {
+    auto first = std::lower_bound(begin, end, low);
+    auto last = std::upper_bound(first, end, high);
+    return {first - begin, last - begin};
+  }
+  // descending coordinates
+  auto first = std::lower_bound(begin, end, high, std::greater<>{});
+  auto last = std::upper_bound(first, end, low, std::greater<>{});
+  return {first - begin, last - begin};
+}
+
+std::optional<AxisPosition> locateCoordinate(std::vector<double> const& values,
+                                             double coordinate) {
+  if (values.empty()) {
+    return std::nullopt;
+  }
+  auto ascending = values.front() <= values.back();
+  auto low = ascending ? values.front() : values.back();
+  auto high = ascending ? values.back() : values.front();
+  // also rejects NaN
+  if (not(coordinate >= low and coordinate <= high)) {
+    return std::nullopt;
+  }
+  // the last point at or before the coordinate
+  auto after = ascending ? std::upper_bound(values.begin(), values.end(),
+                                            coordinate)
+                         : std::upper_bound(values.begin(), values.end(),
+                                            coordinate, std::greater<>{});
+  auto index = static_cast<std::size_t>(after - values.begin()) - 1;
+  if (index + 1 == values.size()) {
+    return AxisPosition{index, 0.0};
+  }
+  return AxisPosition{index, (coordinate - values[index]) /
+                                 (values[index + 1] - values[index])};
+}
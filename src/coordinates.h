@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Returns the half-open index range [first, last) of the coordinates that lie
+// within [low, high], found by binary search. The coordinates must be sorted,
+// either ascending or descending. The range is empty if none lie within.
+std::pair<std::size_t, std::size_t> coordinateRange(
+    std::vector<double> const& values, double low, double high);
+
+// Where a coordinate lies along an axis: weight of the way from the point at
+// index to the point at index + 1. The weight is zero on the last point.
+struct AxisPosition {
+  std::size_t index;
+  double weight;
+};
+
+// Locates a coordinate by binary search over sorted (ascending or descending)
+// coordinates. Returns std::nullopt if it lies outside them.
+std::optional<AxisPosition> locateCoordinate(std::vector<double> const& values,
+                                             double coordinate);
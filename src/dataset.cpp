@@ -0,0 +1,240 @@
+#include "dataset.h"
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+namespace {
+netCDF::NcDim requireDim(netCDF::NcFile const& nc_file,
+                         std::string const& name) {
+  auto dim = nc_file.getDim(name);
+  if (dim.isNull()) {
+    throw std::runtime_error("Dimension '" + name + "' not found.");
+  }
+  return dim;
+}
+
+netCDF::NcVar requireVar(netCDF::NcFile const& nc_file,
+                         std::string const& name) {
+  auto var = nc_file.getVar(name);
+  if (var.isNull()) {
+    throw std::runtime_error("Variable '" + name + "' not found.");
+  }
+  return var;
+}
+}  // namespace
+
+Dataset::Dataset(std::string const& filename, std::size_t slice_cache_bytes)
+    : nc_file_{filename, netCDF::NcFile::read},
+      slice_cache_{slice_cache_bytes} {
+  t_size_ = requireDim(nc_file_, "time").getSize();
+  z_size_ = requireDim(nc_file_, "z").getSize();
+  auto row_size = requireDim(nc_file_, "x").getSize();
+  auto col_size = requireDim(nc_file_, "y").getSize();
+
+  // coordinate arrays are small and never change, so read them up front
+  x_values_.resize(row_size);
+  requireVar(nc_file_, "x").getVar(x_values_.data());
+  y_values_.resize(col_size);
+  requireVar(nc_file_, "y").getVar(y_values_.data());
+
+  // the time coordinate is optional; without it, with a shape other than
+  // (time) or with values that are not ascending, only t indices work
+  auto time = nc_file_.getVar("time");
+  if (not time.isNull() and time.getDimCount() == 1 and
+      time.getDims().front().getName() == "time") {
+    auto time_values = std::vector<double>(t_size_);
+    time.getVar(time_values.data());
+    auto time_attributes = time.getAtts();
+    // getValues throws for a std::string unless the attribute is text
+    auto text_attribute = [&time_attributes](char const* name) {
+      auto text = std::string{};
+      if (auto it = time_attributes.find(name); it != time_attributes.end()) {
+        auto type = it->second.getType().getTypeClass();
+        if (type == netCDF::NcType::nc_CHAR or
+            type == netCDF::NcType::nc_STRING) {
+          it->second.getValues(text);
+        }
+      }
+      return text;
+    };
+    time_axis_ = TimeAxis{std::move(time_values), text_attribute("units"),
+                          text_attribute("calendar")};
+  }
+
+  concentration_ = requireVar(nc_file_, "concentration");
+  auto attributes = concentration_.getAtts();
+  for (auto name : {"_FillValue", "missing_value"}) {
+    if (auto it = attributes.find(name); it != attributes.end()) {
+      it->second.getValues(&fill_value_);
+      break;
+    }
+  }
+}
+
+std::shared_ptr<std::vector<double> const> Dataset::readSlice(
+    std::size_t t_index, std::size_t z_index) const {
+  auto key = SliceKey{"concentration", t_index, z_index};
+  if (auto cached = slice_cache_.get(key)) {
+    return cached;
+  }
+
+  auto concentration_data = std::make_shared<std::vector<double> const>(
+      readSliceUncached(t_index, z_index));
+  slice_cache_.put(key, concentration_data,
+                   concentration_data->size() * sizeof(double));
+  return concentration_data;
+}
+
+std::vector<double> Dataset::readSliceUncached(std::size_t t_index,
+                                               std::size_t z_index) const {
+  auto row_size = xSize();
+  auto col_size = ySize();
+  auto data_start = std::vector<std::size_t>{t_index, z_index, 0, 0};
+  auto data_count = std::vector<std::size_t>{1, 1, col_size, row_size};
+  auto concentration_data = std::vector<double>(row_size * col_size);
+  auto lock = lockFile();
+  concentration_.getVar(data_start, data_count, concentration_data.data());
+  return concentration_data;
+}
+
+std::vector<std::shared_ptr<double const>> Dataset::readSlices(
+    std::vector<std::pair<std::size_t, std::size_t>> const& slices) const {
+  using SlicePtr = std::shared_ptr<double const>;
+  auto found = std::map<std::pair<std::size_t, std::size_t>, SlicePtr>{};
+  for (auto const& [t_index, z_index] : slices) {
+    if (auto [it, inserted] = found.try_emplace({t_index, z_index});
+        inserted) {
+      if (auto cached = slice_cache_.peek(
+              SliceKey{"concentration", t_index, z_index})) {
+        it->second = SlicePtr{cached, cached->data()};
+      }
+    }
+  }
+
+  // runs of consecutive z levels at one time step, in (t, z) order, merged
+  // with identical runs at the following time steps into blocks
+  struct Block {
+    std::size_t t_start;
+    std::size_t t_count;
+    std::size_t z_start;
+    std::size_t z_count;
+  };
+  auto blocks = std::vector<Block>{};
+  auto open_blocks =
+      std::map<std::pair<std::size_t, std::size_t>, std::size_t>{};
+  for (auto it = found.begin(); it != found.end();) {
+    if (it->second) {
+      ++it;
+      continue;
+    }
+    auto [t_index, z_start] = it->first;
+    auto z_end = z_start + 1;
+    for (++it; it != found.end() and not it->second and
+               it->first == std::pair{t_index, z_end};
+         ++it) {
+      ++z_end;
+    }
+    auto z_range = std::pair{z_start, z_end - z_start};
+    if (auto open = open_blocks.find(z_range);
+        open != open_blocks.end() and
+        blocks[open->second].t_start + blocks[open->second].t_count ==
+            t_index) {
+      ++blocks[open->second].t_count;
+    } else {
+      open_blocks[z_range] = blocks.size();
+      blocks.push_back({t_index, 1, z_start, z_end - z_start});
+    }
+  }
+
+  auto slice_size = ySize() * xSize();
+  for (auto const& block : blocks) {
+    auto data_start = std::vector<std::size_t>{block.t_start, block.z_start,
+                                               0, 0};
+    auto data_count = std::vector<std::size_t>{block.t_count, block.z_count,
+                                               ySize(), xSize()};
+    auto block_data = std::make_shared<std::vector<double>>(
+        block.t_count * block.z_count * slice_size);
+    {
+      auto lock = lockFile();
+      concentration_.getVar(data_start, data_count, block_data->data());
+    }
+    // slices share the block rather than copying out of it
+    for (std::size_t t = 0; t < block.t_count; ++t) {
+      for (std::size_t z = 0; z < block.z_count; ++z) {
+        found[{block.t_start + t, block.z_start + z}] = SlicePtr{
+            block_data,
+            block_data->data() + (t * block.z_count + z) * slice_size};
+      }
+    }
+  }
+
+  auto result = std::vector<SlicePtr>{};
+  result.reserve(slices.size());
+  for (auto const& slice : slices) {
+    result.push_back(found[slice]);
+  }
+  return result;
+}
+
+std::vector<double> Dataset::readLevel(std::size_t z_index,
+                                       std::size_t t_start,
+                                       std::size_t t_count) const {
+  auto data_start = std::vector<std::size_t>{t_start, z_index, 0, 0};
+  auto data_count = std::vector<std::size_t>{t_count, 1, ySize(), xSize()};
+  auto level_data = std::vector<double>(t_count * ySize() * xSize());
+  auto lock = lockFile();
+  concentration_.getVar(data_start, data_count, level_data.data());
+  return level_data;
+}
+
+std::vector<double> Dataset::readSeries(std::size_t x_index,
+                                        std::size_t y_index,
+                                        std::size_t z_index) const {
+  auto data_start = std::vector<std::size_t>{0, z_index, y_index, x_index};
+  auto data_count = std::vector<std::size_t>{t_size_, 1, 1, 1};
+  auto series = std::vector<double>(t_size_);
+  auto lock = lockFile();
+  concentration_.getVar(data_start, data_count, series.data());
+  return series;
+}
+
+std::shared_ptr<std::vector<double> const> Dataset::readWindow(
+    std::size_t t_index, std::size_t z_index, Window const& window) const {
+  if (window == fullWindow()) {
+    return readSlice(t_index, z_index);
+  }
+
+  auto concentration_data =
+      std::make_shared<std::vector<double>>(window.y_count * window.x_count);
+  if (auto cached =
+          slice_cache_.peek(SliceKey{"concentration", t_index, z_index})) {
+    auto row_size = xSize();
+    auto* dest = concentration_data->data();
+    for (std::size_t row_idx = 0; row_idx < window.y_count; ++row_idx) {
+      auto const* row =
+          cached->data() +
+          (window.y_start + row_idx * window.stride) * row_size +
+          window.x_start;
+      if (window.stride == 1) {
+        dest = std::copy(row, row + window.x_count, dest);
+        continue;
+      }
+      for (std::size_t col_idx = 0; col_idx < window.x_count; ++col_idx) {
+        *dest++ = row[col_idx * window.stride];
+      }
+    }
+    return concentration_data;
+  }
+
+  auto data_start = std::vector<std::size_t>{t_index, z_index, window.y_start,
+                                             window.x_start};
+  auto data_count =
+      std::vector<std::size_t>{1, 1, window.y_count, window.x_count};
+  auto stride = static_cast<std::ptrdiff_t>(window.stride);
+  auto data_stride = std::vector<std::ptrdiff_t>{1, 1, stride, stride};
+  auto lock = lockFile();
+  concentration_.getVar(data_start, data_count, data_stride,
+                        concentration_data->data());
+  return concentration_data;
+}
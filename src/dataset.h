@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <netcdf>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lru_cache.h"
+#include "time_axis.h"
+
+// Identifies a decoded 2D (y, x) slice of a variable.
+struct SliceKey {
+  std::string variable;
+  std::size_t t_index;
+  std::size_t z_index;
+
+  bool operator==(SliceKey const& other) const {
+    return variable == other.variable and t_index == other.t_index and
+           z_index == other.z_index;
+  }
+};
+
+struct SliceKeyHash {
+  std::size_t operator()(SliceKey const& key) const {
+    auto hash = std::hash<std::string>{}(key.variable);
+    hash = hash * 31 + key.t_index;
+    hash = hash * 31 + key.z_index;
+    return hash;
+  }
+};
+
+using SliceCache = LruCache<SliceKey, std::vector<double>, SliceKeyHash>;
+
+// A rectangular block of a (y, x) slice, sampled every stride points along
+// both axes. The counts are the number of sampled points, so the block spans
+// y_start to y_start + (y_count - 1) * stride.
+struct Window {
+  std::size_t y_start;
+  std::size_t y_count;
+  std::size_t x_start;
+  std::size_t x_count;
+  std::size_t stride = 1;
+
+  bool operator==(Window const& other) const {
+    return y_start == other.y_start and y_count == other.y_count and
+           x_start == other.x_start and x_count == other.x_count and
+           stride == other.stride;
+  }
+};
+
+// Descriptor for the concentration dataset. Dimension sizes, variable handles
+// and coordinate arrays are resolved once when the file is opened, so a request
+// only has to read the hyperslab it asks for.
+//
+// The netCDF-C/HDF5 libraries keep global state and are not safe to call from
+// several threads at once, even through separate file handles. All library
+// calls made through a Dataset are therefore serialized on a single mutex,
+// while the cached descriptor itself can be read concurrently.
+//
+// Decoded slices are kept in a byte-budgeted LRU cache, so repeated requests
+// for the same slice skip decompression and disk I/O entirely.
+class Dataset {
+ public:
+  // Opens the file read-only. Throws netCDF::exceptions::NcException if the
+  // file cannot be opened and std::runtime_error if an expected dimension or
+  // variable is missing. A slice_cache_bytes of zero disables slice caching.
+  explicit Dataset(std::string const& filename,
+                   std::size_t slice_cache_bytes = 0);
+
+  // Direct access to the underlying file. Callers must hold the lock returned
+  // by lockFile() for as long as they use it.
+  netCDF::NcFile const& file() const { return nc_file_; }
+  std::unique_lock<std::mutex> lockFile() const {
+    return std::unique_lock{file_mutex_};
+  }
+
+  std::size_t timeSize() const { return t_size_; }
+  std::size_t zSize() const { return z_size_; }
+  std::size_t ySize() const { return y_values_.size(); }
+  std::size_t xSize() const { return x_values_.size(); }
+
+  std::vector<double> const& xValues() const { return x_values_; }
+  std::vector<double> const& yValues() const { return y_values_; }
+
+  // Values of the "time" coordinate variable, decoded from its units and
+  // calendar attributes where possible. Empty if the file has no such
+  // variable or it is not one-dimensional over the time dimension.
+  TimeAxis const& timeAxis() const { return time_axis_; }
+
+  Window fullWindow() const { return {0, ySize(), 0, xSize()}; }
+
+  // Value marking missing concentration data, from the variable's _FillValue
+  // or missing_value attribute; NaN if it has neither.
+  double fillValue() const { return fill_value_; }
+
+  // Reads the full (y, x) concentration slice at the given time and z indices
+  // in row-major order, from the slice cache if possible. Indices are not
+  // bounds checked. Safe to call from multiple threads.
+  std::shared_ptr<std::vector<double> const> readSlice(
+      std::size_t t_index, std::size_t z_index) const;
+
+  // Same as readSlice but always reads from the file and leaves the slice
+  // cache alone, for bulk scans that would otherwise evict the slices that
+  // clients are actually asking for.
+  std::vector<double> readSliceUncached(std::size_t t_index,
+                                       std::size_t z_index) const;
+
+  // Reads many full slices, given as (t_index, z_index) pairs, and returns
+  // them in the same order, each as a pointer to ySize() * xSize() values.
+  // Cached slices are used as they are. The rest are merged into blocks of
+  // consecutive time steps and z levels, each read with one hyperslab read
+  // and not cached; their slices point into the block, which lives as long
+  // as any of them. Indices are not bounds checked.
+  std::vector<std::shared_ptr<double const>> readSlices(
+      std::vector<std::pair<std::size_t, std::size_t>> const& slices) const;
+
+  // Reads a window of a slice in row-major order. A window covering the whole
+  // slice goes through readSlice. A smaller or strided one is sampled from the
+  // cached slice when there is one and otherwise read as a (strided)
+  // hyperslab of just that window, which is not cached. The window is not
+  // bounds checked.
+  std::shared_ptr<std::vector<double> const> readWindow(
+      std::size_t t_index, std::size_t z_index, Window const& window) const;
+
+  // Reads t_count time steps from t_start of one z level, (time, y, x) in
+  // row-major order, in one hyperslab read. Bypasses the slice cache.
+  // Indices are not bounds checked.
+  std::vector<double> readLevel(std::size_t z_index, std::size_t t_start,
+                                std::size_t t_count) const;
+
+  // Reads the values at one grid point for every time step, in one hyperslab
+  // read. Indices are not bounds checked.
+  std::vector<double> readSeries(std::size_t x_index, std::size_t y_index,
+                                 std::size_t z_index) const;
+
+  SliceCache::Stats sliceCacheStats() const { return slice_cache_.stats(); }
+
+ private:
+  mutable std::mutex file_mutex_;
+  netCDF::NcFile nc_file_;
+  netCDF::NcVar concentration_;
+  std::size_t t_size_;
+  std::size_t z_size_;
+  std::vector<double> x_values_;
+  std::vector<double> y_values_;
+  TimeAxis time_axis_;
+  double fill_value_ = std::numeric_limits<double>::quiet_NaN();
+  mutable SliceCache slice_cache_;
+};
@@ -0,0 +1,49 @@
+#include "etag.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+std::string makeETag(std::string_view content) {
+  // 64-bit FNV-1a
+  auto hash = std::uint64_t{14695981039346656037ull};
+  for (auto c : content) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ull;
+  }
+  char buffer[24];
+  std::snprintf(buffer, sizeof(buffer), "\"%016llx\"",
+                static_cast<unsigned long long>(hash));
+  return buffer;
+}
+
+bool etagMatches(std::string_view if_none_match, std::string_view etag) {
+  auto trim = [](std::string_view text) {
+    while (not text.empty() and (text.front() == ' ' or text.front() == '\t')) {
+      text.remove_prefix(1);
+    }
+    while (not text.empty() and (text.back() == ' ' or text.back() == '\t')) {
+      text.remove_suffix(1);
+    }
+    return text;
+  };
+  auto opaque = [](std::string_view tag) {
+    if (tag.substr(0, 2) == "W/") {
+      tag.remove_prefix(2);
+    }
+    return tag;
+  };
+
+  if (trim(if_none_match) == "*") {
+    return true;
+  }
+  while (not if_none_match.empty()) {
+    auto end = std::min(if_none_match.find(','), if_none_match.size());
+    auto candidate = trim(if_none_match.substr(0, end));
+    if_none_match.remove_prefix(std::min(end + 1, if_none_match.size()));
+    if (opaque(candidate) == opaque(etag)) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// Returns a strong entity tag (including the surrounding quotes) derived from
+// the content, suitable for an ETag header.
+std::string makeETag(std::string_view content);
+
+// Whether an If-None-Match header value matches the given entity tag, using
+// the weak comparison that RFC 9110 prescribes for If-None-Match.
+bool etagMatches(std::string_view if_none_match, std::string_view etag);
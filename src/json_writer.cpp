@@ -0,0 +1,151 @@
+#include "json_writer.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+void JsonWriter::key(std::string_view name) {
+  value(name);
+  out_ += indent_ > 0 ? ": " : ":";
+  after_key_ = true;
+}
+
+void JsonWriter::value(double number) {
+  separate();
+  // JSON has no representation for NaN or infinity
+  if (not std::isfinite(number)) {
+    out_ += "null";
+    return;
+  }
+  // shortest round-trip digits, laid out the way nlohmann's dump() does:
+  // plain decimals for decimal exponents in (-4, 15], scientific otherwise
+  char buffer[32];
+  auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), number,
+                                 std::chars_format::scientific);
+  auto text = std::string_view(buffer, end - buffer);
+  if (text.front() == '-') {
+    out_ += '-';
+    text.remove_prefix(1);
+  }
+  auto e_pos = text.find('e');
+  auto digits = std::string{text.substr(0, e_pos)};
+  if (digits.size() > 1) {
+    digits.erase(1, 1);  // the decimal point
+  }
+  auto exponent = 0;
+  auto exponent_text = text.substr(e_pos + 1);
+  if (exponent_text.front() == '+') {
+    exponent_text.remove_prefix(1);
+  }
+  std::from_chars(exponent_text.data(),
+                  exponent_text.data() + exponent_text.size(), exponent);
+
+  // the decimal point goes after the first point_pos digits
+  auto digit_count = static_cast<int>(digits.size());
+  auto point_pos = exponent + 1;
+  if (digit_count <= point_pos and point_pos <= 15) {
+    out_ += digits;
+    out_.append(point_pos - digit_count, '0');
+    out_ += ".0";
+  } else if (0 < point_pos and point_pos <= 15) {
+    out_.append(digits, 0, point_pos);
+    out_ += '.';
+    out_.append(digits, point_pos);
+  } else if (-4 < point_pos and point_pos <= 0) {
+    out_ += "0.";
+    out_.append(-point_pos, '0');
+    out_ += digits;
+  } else {
+    out_ += digits[0];
+    if (digit_count > 1) {
+      out_ += '.';
+      out_.append(digits, 1);
+    }
+    out_ += exponent < 0 ? "e-" : "e+";
+    auto magnitude = std::abs(exponent);
+    if (magnitude < 10) {
+      out_ += '0';
+    }
+    out_ += std::to_string(magnitude);
+  }
+}
+
+void JsonWriter::value(std::size_t number) {
+  separate();
+  char buffer[24];
+  auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), number);
+  out_.append(buffer, end);
+}
+
+void JsonWriter::value(std::string_view text) {
+  separate();
+  out_ += '"';
+  for (auto c : text) {
+    switch (c) {
+      case '"':
+        out_ += "\\\"";
+        break;
+      case '\\':
+        out_ += "\\\\";
+        break;
+      case '\n':
+        out_ += "\\n";
+        break;
+      case '\r':
+        out_ += "\\r";
+        break;
+      case '\t':
+        out_ += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char escaped[8];
+          std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          out_ += escaped;
+        } else {
+          out_ += c;
+        }
+    }
+  }
+  out_ += '"';
+}
+
+void JsonWriter::open(char bracket) {
+  separate();
+  out_ += bracket;
+  empty_.push_back(true);
+}
+
+void JsonWriter::close(char bracket) {
+  auto was_empty = empty_.back();
+  empty_.pop_back();
+  if (not was_empty) {
+    newline();
+  }
+  out_ += bracket;
+}
+
+// Emits whatever has to precede the next value: nothing after a key, a comma
+// between elements, and a line break with indentation when pretty printing.
+void JsonWriter::separate() {
+  if (after_key_) {
+    after_key_ = false;
+    return;
+  }
+  if (empty_.empty()) {
+    return;
+  }
+  if (not empty_.back()) {
+    out_ += ',';
+  }
+  empty_.back() = false;
+  newline();
+}
+
+void JsonWriter::newline() {
+  if (indent_ > 0) {
+    out_ += '\n';
+    out_.append(empty_.size() * indent_, ' ');
+  }
+}
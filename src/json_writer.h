@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Minimal streaming JSON writer. Values are appended straight to an output
+// string without building a document tree, which keeps large responses cheap
+// to produce. With a nonzero indent the output is laid out like
+// nlohmann::json::dump(indent).
+//
+// The writer does not validate structure; callers are expected to pair
+// begin/end calls and to write a key before each value inside an object.
+class JsonWriter {
+ public:
+  explicit JsonWriter(std::string& out, int indent = 0)
+      : out_{out}, indent_{indent} {}
+
+  void beginObject() { open('{'); }
+  void endObject() { close('}'); }
+  void beginArray() { open('['); }
+  void endArray() { close(']'); }
+
+  void key(std::string_view name);
+  void value(double number);
+  void value(std::size_t number);
+  void value(std::string_view text);
+
+ private:
+  void open(char bracket);
+  void close(char bracket);
+  void separate();
+  void newline();
+
+  std::string& out_;
+  int indent_;
+  // one entry per open container: whether it has no elements yet
+  std::vector<bool> empty_;
+  bool after_key_ = false;
+};
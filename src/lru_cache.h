@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+// Thread-safe least-recently-used cache with a budget in bytes. Values are
+// handed out as shared pointers, so an entry that is evicted while a caller is
+// still using it stays alive until the caller releases it. The caller reports
+// the size of each value on insertion; a budget of zero disables the cache.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache {
+ public:
+  struct Stats {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+    std::size_t entries = 0;
+    std::size_t bytes = 0;
+    std::size_t capacity_bytes = 0;
+  };
+
+  explicit LruCache(std::size_t capacity_bytes)
+      : capacity_bytes_{capacity_bytes} {}
+
+  // Returns the cached value and marks it as most recently used, or nullptr if
+  // the key is not cached.
+  std::shared_ptr<Value const> get(Key const& key) {
+    auto lock = std::lock_guard{mutex_};
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      ++misses_;
+      return nullptr;
+    }
+    ++hits_;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->value;
+  }
+
+  // Like get, but neither counts a hit or miss nor marks the entry as recently
+  // used, for callers that only take advantage of a value that happens to be
+  // cached and would never insert it.
+  std::shared_ptr<Value const> peek(Key const& key) const {
+    auto lock = std::lock_guard{mutex_};
+    auto it = index_.find(key);
+    return it == index_.end() ? nullptr : it->second->value;
+  }
+
+  // Inserts or replaces a value, evicting least recently used entries until
+  // the cache fits its budget. Values larger than the whole budget are not
+  // cached.
+  void put(Key const& key, std::shared_ptr<Value const> value,
+           std::size_t bytes) {
+    auto lock = std::lock_guard{mutex_};
+    if (auto it = index_.find(key); it != index_.end()) {
+      bytes_ -= it->second->bytes;
+      entries_.erase(it->second);
+      index_.erase(it);
+    }
+    if (bytes > capacity_bytes_) {
+      return;
+    }
+    while (bytes_ + bytes > capacity_bytes_) {
+      auto const& oldest = entries_.back();
+      bytes_ -= oldest.bytes;
+      index_.erase(oldest.key);
+      entries_.pop_back();
+      ++evictions_;
+    }
+    entries_.push_front(Entry{key, std::move(value), bytes});
+    index_.emplace(key, entries_.begin());
+    bytes_ += bytes;
+  }
+
+  Stats stats() const {
+    auto lock = std::lock_guard{mutex_};
+    return {hits_, misses_, evictions_, index_.size(), bytes_,
+            capacity_bytes_};
+  }
+
+ private:
+  struct Entry {
+    Key key;
+    std::shared_ptr<Value const> value;
+    std::size_t bytes;
+  };
+
+  mutable std::mutex mutex_;
+  std::size_t capacity_bytes_;
+  std::size_t bytes_ = 0;
+  std::list<Entry> entries_;
+  std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> index_;
+  std::uint64_t hits_ = 0;
+  std::uint64_t misses_ = 0;
+  std::uint64_t evictions_ = 0;
+};
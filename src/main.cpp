@@ -4,111 +4,598 @@
 #include <sys/types.h>
 
 #include <algorithm>
-#include <cstdint>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
 #include <exception>
 #include <iostream>
-#include <json.hpp>
 #include <limits>
+#include <json.hpp>
+#include <memory>
 #include <netcdf>
+#include <optional>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
+#include "aggregate.h"
+#include "apng.h"
+#include "arrow_ipc.h"
+#include "binary_formats.h"
+#include "compression.h"
+#include "colormap.h"
+#include "coordinates.h"
+#include "dataset.h"
+#include "etag.h"
+#include "json_writer.h"
+#include "lru_cache.h"
+#include "parallel.h"
+#include "render.h"
+#include "resample.h"
+#include "series_index.h"
+#include "statistics.h"
+#include "tiles.h"
 
 using json = nlohmann::json;
 
 struct GridData {
   std::vector<double> x_values;
   std::vector<double> y_values;
-  std::vector<double> concentration_values;
+  std::shared_ptr<std::vector<double> const> concentration_values;
+};
+
+// Describes the dimensions and variables of the file.
+json getInfo(Dataset const& dataset);
+
+// A bounds-checked choice of slice, parsed from the request parameters. The
+// window restricts the slice to a spatial subset given either as index ranges
+// (x0, x1, y0, y1) or as a coordinate bounding box (bbox), optionally
+// decimated by a stride.
+struct SliceSelection {
+  std::size_t t_index;
+  std::size_t z_index;
+  Window window;
+};
+
+SliceSelection getSliceSelection(Dataset const& dataset,
+                                 crow::request const& request);
+GridData getGridData(Dataset const& dataset, SliceSelection const& selection);
+
+// The x and y coordinates of a window, without reading any values.
+GridData getGridCoordinates(Dataset const& dataset, Window const& window);
+Window getWindow(Dataset const& dataset, crow::request const& request);
+
+// Reads the time step, given either as an index in 't' or as a time in
+// 'time'. Throws BadRequest if there is neither or the step does not exist.
+std::size_t getTimeIndex(Dataset const& dataset, crow::request const& request);
+
+// Resolves a time, an ISO 8601 date and time or a value of the time
+// coordinate, to the nearest time step by binary search over the dataset's
+// time axis. Throws BadRequest if the time lies outside the axis or cannot be
+// interpreted.
+std::size_t findTimeIndex(Dataset const& dataset, std::string const& time);
+std::size_t findTimeIndex(Dataset const& dataset, double time_value);
+
+// Parses an optional non-negative integer query parameter.
+std::size_t parseIndex(crow::request const& request, char const* name,
+                       std::size_t default_value);
+
+// Parses an optional finite number query parameter.
+std::optional<double> parseNumber(crow::request const& request,
+                                  char const* name);
+
+// Parses a comma-separated list of finite numbers from query parameter name.
+std::vector<double> parseNumberList(std::string const& text, char const* name);
+GridData getGridData(Dataset const& dataset, crow::request const& request);
+
+// Encoded PNGs keyed by the canonical form of the selection and the render
+// options. The file is read-only, so entries never go stale.
+using ImageCache = LruCache<std::string, RenderedImage>;
+
+// Reads the 'cmap', 'vmin', 'vmax' and 'scale' query parameters. scale=level
+// or scale=global default the color range to the extrema of the selected z
+// level over all time steps or of the whole variable, rather than of the
+// slice; vmin and vmax still take precedence.
+RenderOptions getColorOptions(StatsIndex const& stats_index,
+                              SliceSelection const& selection,
+                              crow::request const& request);
+
+// Sets the color bounds left open in options to range, the extrema of the
+// values being drawn (NaN when there are none). Throws BadRequest if a lone
+// vmin or vmax given by the client is not below or above the other, which
+// would draw every value in one color.
+void resolveColorRange(RenderOptions& options, ValueRange range);
+
+// Reads the /get-image color options and also 'width' and 'height' (the
+// other following the aspect ratio when only one is given) or an integer
+// 'zoom' to set the output size, and 'resample' to pick nearest (default) or
+// bilinear resampling.
+RenderOptions getRenderOptions(StatsIndex const& stats_index,
+                               SliceSelection const& selection,
+                               crow::request const& request);
+
+std::string imageCacheKey(SliceSelection const& selection,
+                          RenderOptions const& render_options);
+
+// Pyramids of recently tiled slices, and rendered tiles keyed like images.
+using PyramidCache = LruCache<SliceKey, TilePyramid, SliceKeyHash>;
+
+std::shared_ptr<TilePyramid const> getPyramid(Dataset const& dataset,
+                                              PyramidCache& pyramid_cache,
+                                              std::size_t t_index,
+                                              std::size_t z_index);
+
+// Sends a rendered PNG with its ETag, or 304 if it matches If-None-Match.
+crow::response imageResponse(RenderedImage const& image,
+                             crow::request const& request);
+
+// Largest image /get-image will render, in pixels, which bounds the memory a
+// request can make the server allocate.
+constexpr std::size_t kMaxImagePixels = std::size_t{1} << 22;
+
+// Limits on /get-animation: the number of frames, and the pixels of all
+// frames together.
+constexpr std::size_t kMaxAnimationFrames = 1024;
+constexpr std::size_t kMaxAnimationPixels = kMaxImagePixels * 16;
+
+// Every time step from t0 to t1 (inclusive) of a window at one z level.
+struct RangeSelection {
+  std::size_t t0;
+  std::size_t t1;
+  std::size_t z_index;
+  Window window;
+};
+
+// Reads the required 't0', 't1' and 'z' query parameters and the window.
+RangeSelection getRangeSelection(Dataset const& dataset,
+                                 crow::request const& request);
+
+// A range rendered with common options and shown for delay_ms per frame.
+// With frame_range, the color bounds not set in render_options are still to be
+// found from the extrema of the windows of all frames.
+struct AnimationSelection : RangeSelection {
+  RenderOptions render_options;
+  unsigned delay_ms;
+  bool frame_range;
 };
 
-GridData getGridData(netCDF::NcFile const& nc_file,
-                     crow::request const& request);
+// Reads the /get-animation parameters: 't0', 't1' and 'z', the window and
+// image options of /get-image, and 'delay' in milliseconds. Unless 'scale'
+// says otherwise, a color bound not given by 'vmin' or 'vmax' comes from the
+// extrema of the animated windows, so that all frames share one scale. For
+// full slices these are known from the stats index; for smaller windows they
+// are left to renderAnimation.
+AnimationSelection getAnimationSelection(Dataset const& dataset,
+                                         StatsIndex const& stats_index,
+                                         crow::request const& request);
+
+std::string animationCacheKey(AnimationSelection const& selection);
+
+// Renders the frames as an animated PNG. Slices are read (one at a time, as
+// the dataset serializes file access) and rendered in parallel on up to
+// thread_count threads. With frame_range the windows are read twice: once to
+// find the common color range, then to render, so that no more than one
+// window per thread is held at a time.
+RenderedImage renderAnimation(Dataset const& dataset,
+                              AnimationSelection const& selection,
+                              unsigned thread_count);
+
+// Where a point given in coordinate values lies within the grid.
+struct GridPoint {
+  AxisPosition x;
+  AxisPosition y;
+};
+
+// Locates coordinates (x, y) by binary search over the cached coordinate
+// arrays. Throws BadRequest if they lie outside the grid.
+GridPoint locatePoint(Dataset const& dataset, double x, double y);
+
+// Bilinearly interpolates a slice at a point, reading only the (at most) 2x2
+// grid points around it. NaN if a grid point it draws on is missing.
+double readValue(Dataset const& dataset, std::size_t t_index,
+                 std::size_t z_index, GridPoint const& point);
+
+// A /sample location: where it lies in the grid, if inside it, and which
+// slice it samples.
+struct SamplePoint {
+  std::optional<GridPoint> point;
+  std::size_t t_index;
+  std::size_t z_index;
+};
+
+// Most points /sample takes in one request.
+constexpr std::size_t kMaxSamplePoints = std::size_t{1} << 20;
+
+// Reads a /sample body, {"points": [{"x": ..., "y": ..., "t": ...}, ...]},
+// with x and y in coordinate values, a t index (or a "time" as /get-data
+// takes it) and an optional z index (default 0).
+std::vector<SamplePoint> getSamplePoints(Dataset const& dataset,
+                                         crow::request const& request);
+
+// Interpolates every point like readValue, returning the values in input
+// order; points outside the grid are NaN. Points are grouped by slice and each
+// slice is read once, as the smallest window holding all of its points.
+std::vector<double> samplePoints(Dataset const& dataset,
+                                 std::vector<SamplePoint> const& points);
+
+// Serializes grid data as JSON into out. The array-of-structs layout nests one
+// {concentration, x, y} object per cell in a row-major array of rows. The
+// struct-of-arrays layout lists the x and y coordinates once and flattens the
+// concentration values in row-major order, with their (y, x) shape alongside.
+void writeGridJsonAos(GridData const& grid_data, ResponseBody& body);
+void writeGridJsonSoa(GridData const& grid_data, ResponseBody& body);
+
+// Serializes grid data as an Arrow IPC stream with one row per cell and x, y
+// and concentration columns, the tabular equivalent of the JSON layout.
+void writeGridArrow(GridData const& grid_data, DType dtype, std::string& out);
+
+// Describes a binary encoded slice in response headers: X-Shape, X-Dtype,
+// X-Byte-Order and the coordinates as JSON arrays in X-X-Values and
+// X-Y-Values.
+void setGridHeaders(GridData const& grid_data, DType dtype,
+                    crow::response& response);
+void setArrayHeaders(std::vector<std::size_t> const& shape,
+                     std::vector<double> const& x_values,
+                     std::vector<double> const& y_values, DType dtype,
+                     crow::response& response);
+
+// (t_index, z_index) pairs of full slices requested from /get-batch.
+using SliceList = std::vector<std::pair<std::size_t, std::size_t>>;
+
+// Most values /get-batch returns in one response.
+constexpr std::size_t kMaxBatchValues = std::size_t{1} << 24;
+
+// Expands a /get-batch body, {"slices": [{"t": ..., "z": ...}, ...]} where t
+// and z are each an index or an inclusive [first, last] range, into slices in
+// the order given, time-major within an entry.
+SliceList getBatchSlices(Dataset const& dataset, crow::request const& request);
+
+// Serializes batch slices as JSON: the coordinates once, then one object
+// with the indices and row-major concentration values per slice.
+void writeBatchJson(Dataset const& dataset, SliceList const& slices,
+                    std::vector<std::shared_ptr<double const>> const& values,
+                    ResponseBody& body);
+
+// Encoding to compress a response with, from the Accept-Encoding header.
+ContentEncoding acceptedEncoding(crow::request const& request);
+
+// Reads the optional 'dtype' query parameter for binary outputs (default
+// float64).
+DType getDType(crow::request const& request);
+
+// Picks the /get-data output format from the 'format' query parameter or,
+// failing that, the Accept header: "json" (default), "npy" or "arrow".
+std::string getDataFormat(crow::request const& request);
+
+// Adds Accept to the Vary header when the format was negotiated from the
+// Accept header rather than given by 'format', so shared caches keep the
+// formats apart. Call after the body has set its own Vary.
+void varyOnAccept(crow::request const& request, crow::response& response);
+
+// How /get-data serializes a grid: the format, the JSON 'layout' ("aos" or
+// "soa") and the binary 'dtype'.
+struct OutputFormat {
+  std::string format;
+  std::string layout;
+  DType dtype;
+};
+
+OutputFormat getOutputFormat(crow::request const& request);
+
+// Serializes grid data as requested, compressed as the client accepts.
+crow::response dataResponse(GridData const& grid_data,
+                            OutputFormat const& output_format,
+                            crow::request const& request,
+                            CompressionOptions const& compression);
+
+struct Options {
+  std::string nc_filename;
+  unsigned thread_count = std::max(1u, std::thread::hardware_concurrency());
+  std::size_t slice_cache_mb = 256;
+  std::size_t image_cache_mb = 64;
+  std::size_t pyramid_cache_mb = 256;
+  std::size_t tile_cache_mb = 64;
+  SeriesIndex::Mode series_index = SeriesIndex::Mode::Lazy;
+  std::size_t series_index_mb = 512;
+  StatsIndex::Mode stats_index = StatsIndex::Mode::Background;
+  CompressionOptions compression;
+};
+
+std::optional<Options> parseOptions(int argc, char* argv[]);
 
 struct BadRequest : public std::runtime_error {
   BadRequest(std::string const& what_arg) : std::runtime_error(what_arg) {}
 };
+struct NotFound : public std::runtime_error {
+  NotFound(std::string const& what_arg) : std::runtime_error(what_arg) {}
+};
 struct InternalServerError : public std::runtime_error {
   InternalServerError(std::string const& what_arg)
       : std::runtime_error(what_arg) {}
 };
 
 int main(int argc, char* argv[]) {
-  // Read input filename from command line
-  if (argc != 2) {
-    std::cout << "Usage: " << argv[0] << "NetCDF-filename\n";
+  // Read input filename and options from command line
+  auto const options = parseOptions(argc, argv);
+  if (not options) {
+    std::cout << "Usage: " << argv[0]
+              << " [--threads N] [--cache-mb N] [--image-cache-mb N]"
+                 " [--pyramid-cache-mb N] [--tile-cache-mb N]"
+                 " [--series-index off|lazy|startup] [--series-index-mb N]"
+                 " [--stats-index lazy|background]"
+                 " [--compression-level N] [--compression-min-bytes N]"
+                 " NetCDF-filename\n";
     return EXIT_FAILURE;
   }
-  auto nc_filename = std::string{argv[1]};
 
-  // open the file
-  auto nc_file = [&nc_filename] {
+  // open the file and resolve the dataset layout
+  auto const dataset = [&options] {
     try {
-      return netCDF::NcFile{nc_filename, netCDF::NcFile::read};
+      return Dataset{options->nc_filename,
+                     options->slice_cache_mb * 1024 * 1024};
     } catch (netCDF::exceptions::NcNotNCF const& e) {
       std::cerr << e.what() << '\n';
       exit(EXIT_FAILURE);
+    } catch (std::runtime_error const& e) {
+      std::cerr << e.what() << '\n';
+      exit(EXIT_FAILURE);
     }
   }();
 
+  // the file is read-only, so the metadata document is built, serialized and
+  // compressed once
+  auto const info = [&dataset, &options] {
+    try {
+      return PrecompressedBody{getInfo(dataset).dump(2), options->compression};
+    } catch (netCDF::exceptions::NcException const& e) {
+      std::cerr << "Failed to read the file metadata: " << e.what() << '\n';
+      exit(EXIT_FAILURE);
+    }
+  }();
+  // each content-coding is a different representation, so each variant
+  // needs its own strong tag
+  auto const info_etag = makeETag(info.identity());
+  auto const variant_etag = [&info_etag](ContentEncoding encoding) {
+    auto etag = info_etag;
+    if (encoding != ContentEncoding::Identity) {
+      etag.insert(etag.size() - 1, "-" + std::string{encodingName(encoding)});
+    }
+    return etag;
+  };
+
+  auto image_cache = ImageCache{options->image_cache_mb * 1024 * 1024};
+  auto pyramid_cache =
+      PyramidCache{options->pyramid_cache_mb * 1024 * 1024};
+  auto tile_cache = ImageCache{options->tile_cache_mb * 1024 * 1024};
+  auto const series_index = SeriesIndex{
+      dataset, options->series_index, options->series_index_mb * 1024 * 1024};
+  auto const stats_index = StatsIndex{dataset, options->stats_index};
+
   crow::SimpleApp app;
 
   CROW_ROUTE(app, "/")([] {
     return "Usage:\n"
            "/get-info to display file metadata\n"
            "/get-data?t=t_index&z=z_index to display JSON of concentration "
-           "data\n"
+           "data (add &layout=soa for a compact struct-of-arrays layout, or "
+           "&format=npy or &format=arrow for binary output)\n"
+           "POST /get-batch with {\"slices\": [{\"t\": t, \"z\": z}, ...]}, "
+           "where t and z may be [first, last] ranges, to fetch many slices "
+           "at once as JSON or &format=npy\n"
+           "/get-raw?t=t_index&z=z_index[&dtype=float32] to download "
+           "concentration data as little-endian binary\n"
            "/get-image?t=t_index&z=z_index to display PNG of concentration "
-           "data";
+           "data (add &cmap=viridis, magma or diverging for false color and "
+           "&vmin=&vmax= to fix the color range, or &scale=level or "
+           "&scale=global to share it across time steps, and &width=&height= "
+           "or &zoom=n with &resample=nearest or bilinear to resize it)\n"
+           "/get-data, /get-raw and /get-image accept &x0=&x1=&y0=&y1= index "
+           "ranges or &bbox=xmin,ymin,xmax,ymax to select a region, and "
+           "&stride=n to keep every n-th point\n"
+           "/get-animation?t0=t_index&t1=t_index&z=z_index to display an "
+           "animated PNG of the time steps from t0 to t1 (accepts the "
+           "/get-image options and &delay=milliseconds)\n"
+           "/get-aggregate?op=mean&t0=t_index&t1=t_index&z=z_index to "
+           "display the mean, min, max or sum over a time range (accepts the "
+           "/get-data formats and &format=png with the /get-image options)\n"
+           "/get-value?x=x&y=y&t=t_index&z=z_index to display the "
+           "concentration interpolated at coordinates (x, y)\n"
+           "POST /sample with {\"points\": [{\"x\": x, \"y\": y, \"t\": "
+           "t_index}, ...]} to interpolate many points at once\n"
+           "/get-series?x=x_index&y=y_index&z=z_index to display JSON of the "
+           "concentration at one grid point over time\n"
+           "/get-stats?t=t_index&z=z_index to display summary statistics and "
+           "a histogram of concentration data\n"
+           "/tiles/t_index/z_index/level/tx/ty.png to fetch 256x256 map tiles "
+           "of concentration data (accepts the /get-image color options)\n"
+           "/get-cache-stats to display cache counters\n"
+           "Wherever a single time step is selected, t=t_index may be "
+           "replaced by time=ISO-8601-date-or-time-value";
   });
 
-  CROW_ROUTE(app, "/get-info")([&nc_file] {
-    // dimensions
-    auto dims = json::object();
-    for (auto const& [dim_name, dim] : nc_file.getDims()) {
-      dims[dim_name] = dim.getSize();
+  CROW_ROUTE(app, "/get-info")([&info,
+                                &variant_etag](crow::request const& request) {
+    auto response = crow::response{};
+    auto encoding = acceptedEncoding(request);
+    auto etag = variant_etag(info.variant(encoding));
+    response.set_header("ETag", etag);
+    auto const& if_none_match = request.get_header_value("If-None-Match");
+    if (not if_none_match.empty() and etagMatches(if_none_match, etag)) {
+      response.code = 304;  // not modified
+      info.setVary(response);
+      return response;
     }
+    info.finish(encoding, response);
+    return response;
+  });
 
-    // variables
-    auto vars = json::object();
-    for (auto const& [var_name, var] : nc_file.getVars()) {
-      auto var_info = json{};
-      var_info["type"] = var.getType().getName();
+  CROW_ROUTE(app, "/get-data")
+      .methods("GET"_method)([&dataset,
+                              &options](crow::request const& request) {
+        auto result = json();
+        auto grid_data = GridData{};
+        auto output_format = OutputFormat{};
+        try {
+          output_format = getOutputFormat(request);
+          grid_data = getGridData(dataset, request);
+        } catch (BadRequest const& e) {
+          result["error"] = e.what();
+          return crow::response(400, result.dump());
+        } catch (InternalServerError const& e) {
+          result["error"] = e.what();
+          return crow::response(500, result.dump());
+        }
+        return dataResponse(grid_data, output_format, request,
+                            options->compression);
+      });
 
-      auto dim_names = std::vector<std::string>{};
-      for (auto const& dim : var.getDims()) {
-        dim_names.push_back(dim.getName());
-      }
-      var_info["dimensions"] = dim_names;
+  CROW_ROUTE(app, "/get-aggregate")
+      .methods("GET"_method)([&dataset, &image_cache, &stats_index,
+                              &options](crow::request const& request) {
+        auto result = json();
+        auto grid_data = GridData{};
+        auto output_format = OutputFormat{};
+        auto image = std::shared_ptr<RenderedImage const>{};
+        try {
+          char const* op_param = request.url_params.get("op");
+          if (not op_param) {
+            throw BadRequest("Missing query parameter 'op'.");
+          }
+          auto op = parseAggregateOp(op_param);
+          if (not op) {
+            throw BadRequest("op must be one of mean, min, max or sum.");
+          }
+          auto selection = getRangeSelection(dataset, request);
+          char const* format_param = request.url_params.get("format");
+          auto as_image =
+              format_param and std::string_view{format_param} == "png";
+          auto render_options = RenderOptions{};
+          // level and global extrema describe raw slices, not composites
+          if (char const* scale_param = request.url_params.get("scale");
+              as_image and scale_param and
+              std::string_view{scale_param} != "slice") {
+            throw BadRequest("Aggregates only support scale=slice.");
+          }
+          if (as_image) {
+            render_options = getRenderOptions(
+                stats_index,
+                SliceSelection{selection.t0, selection.z_index,
+                               selection.window},
+                request);
+          } else {
+            output_format = getOutputFormat(request);
+          }
 
-      auto attributes = json::object();
-      for (auto const& [attribute_name, attribute] : var.getAtts()) {
-        auto value = std::string{};
-        attribute.getValues(value);
-        attributes[attribute_name] = value;
-      }
-      var_info["attributes"] = attributes;
+          // composites are rendered on every request, but images are cached
+          // like any other
+          auto key = std::string{};
+          if (as_image) {
+            key = "aggregate:" + std::string{aggregateOpName(*op)} + ":" +
+                  imageCacheKey(SliceSelection{selection.t0, selection.z_index,
+                                               selection.window},
+                                render_options) +
+                  "&t1=" + std::to_string(selection.t1);
+            image = image_cache.get(key);
+            if (image) {
+              return imageResponse(*image, request);
+            }
+          }
+          grid_data = getGridCoordinates(dataset, selection.window);
+          grid_data.concentration_values =
+              std::make_shared<std::vector<double> const>(aggregate(
+                  dataset, selection.t0, selection.t1, selection.z_index,
+                  selection.window, *op, options->thread_count));
+          if (as_image) {
+            if (not render_options.vmin or not render_options.vmax) {
+              resolveColorRange(render_options,
+                                findRange(*grid_data.concentration_values,
+                                          dataset.fillValue()));
+            }
+            auto png = renderPng(*grid_data.concentration_values,
+                                 grid_data.x_values.size(),
+                                 grid_data.y_values.size(),
+                                 dataset.fillValue(), render_options);
+            auto etag = makeETag(png);
+            auto rendered = std::make_shared<RenderedImage const>(
+                RenderedImage{std::move(png), std::move(etag)});
+            image_cache.put(key, rendered, rendered->png.size());
+            image = rendered;
+          }
+        } catch (BadRequest const& e) {
+          result["error"] = e.what();
+          return crow::response(400, result.dump());
+        } catch (InternalServerError const& e) {
+          result["error"] = e.what();
+          return crow::response(500, result.dump());
+        }
+        if (image) {
+          return imageResponse(*image, request);
+        }
+        return dataResponse(grid_data, output_format, request,
+                            options->compression);
+      });
 
-      vars[var_name] = var_info;
-    }
+  CROW_ROUTE(app, "/get-batch")
+      .methods("POST"_method)([&dataset,
+                               &options](crow::request const& request) {
+        auto result = json();
+        auto slices = SliceList{};
+        auto values = std::vector<std::shared_ptr<double const>>{};
+        auto format = std::string{};
+        auto dtype = DType::Float64;
+        try {
+          format = getDataFormat(request);
+          if (format == "arrow") {
+            throw BadRequest("format must be 'json' or 'npy' for batches.");
+          }
+          dtype = getDType(request);
+          slices = getBatchSlices(dataset, request);
+          values = dataset.readSlices(slices);
+        } catch (BadRequest const& e) {
+          result["error"] = e.what();
+          return crow::response(400, result.dump());
+        } catch (InternalServerError const& e) {
+          result["error"] = e.what();
+          return crow::response(500, result.dump());
+        }
 
-    // result
-    auto result = json{};
-    result["dimensions"] = dims;
-    result["variables"] = vars;
-    return crow::response(result.dump(2));
-  });
+        auto response = crow::response{};
+        auto body =
+            ResponseBody{acceptedEncoding(request), options->compression};
+        if (format == "npy") {
+          // one (slice, y, x) array, slices in request order
+          auto shape = std::vector<std::size_t>{slices.size(), dataset.ySize(),
+                                                dataset.xSize()};
+          response.set_header("Content-Type", "application/x-npy");
+          setArrayHeaders(shape, dataset.xValues(), dataset.yValues(), dtype,
+                          response);
+          appendNpyHeader(shape, dtype, body.text());
+          for (auto const& slice : values) {
+            appendLittleEndian(slice.get(), dataset.ySize() * dataset.xSize(),
+                               dtype, body.text());
+            body.flush();
+          }
+        } else {
+          writeBatchJson(dataset, slices, values, body);
+        }
+        body.finish(response);
+        varyOnAccept(request, response);
+        return response;
+      });
 
-  CROW_ROUTE(app, "/get-data")
-      .methods("GET"_method)([&nc_file](crow::request const& request) {
+  CROW_ROUTE(app, "/get-raw")
+      .methods("GET"_method)([&dataset,
+                              &options](crow::request const& request) {
         auto result = json();
         auto grid_data = GridData{};
+        auto dtype = DType::Float64;
         try {
-          grid_data = getGridData(nc_file, request);
+          dtype = getDType(request);
+          grid_data = getGridData(dataset, request);
         } catch (BadRequest const& e) {
           result["error"] = e.what();
           return crow::response(400, result.dump());
@@ -116,36 +603,189 @@ int main(int argc, char* argv[]) {
           result["error"] = e.what();
           return crow::response(500, result.dump());
         }
-        auto const& [x_values, y_values, concentration_data] = grid_data;
-        auto row_size = x_values.size();
-        auto col_size = y_values.size();
 
-        // make nested array
-        auto grid = json::array();
-        for (std::size_t row_idx = 0; row_idx < col_size; ++row_idx) {
-          auto row = json::array();
-          for (std::size_t col_idx = 0; col_idx < row_size; ++col_idx) {
-            // Array of structs is chosen for display purposes. Struct of
-            // arrays may be preferred if the purpose is to read the data into
-            // data structures.
-            row.push_back({{"x", x_values[col_idx]},
-                           {"y", y_values[row_idx]},
-                           {"concentration",
-                            concentration_data[row_idx * row_size + col_idx]}});
+        // shape, type and coordinates travel in headers so the body is just
+        // the row-major concentration values
+        auto response = crow::response{};
+        response.set_header("Content-Type", "application/octet-stream");
+        setGridHeaders(grid_data, dtype, response);
+        auto body =
+            ResponseBody{acceptedEncoding(request), options->compression};
+        appendLittleEndian(*grid_data.concentration_values, dtype,
+                           body.text());
+        body.finish(response);
+        return response;
+      });
+
+  CROW_ROUTE(app, "/get-image")
+      .methods("GET"_method)([&dataset, &image_cache,
+                              &stats_index](crow::request const& request) {
+        auto result = json();
+        auto image = std::shared_ptr<RenderedImage const>{};
+        try {
+          auto selection = getSliceSelection(dataset, request);
+          auto render_options =
+              getRenderOptions(stats_index, selection, request);
+          auto key = imageCacheKey(selection, render_options);
+          image = image_cache.get(key);
+          if (not image) {
+            auto grid_data = getGridData(dataset, selection);
+            auto const& [x_values, y_values, concentration_values] =
+                grid_data;
+            if (not render_options.vmin or not render_options.vmax) {
+              resolveColorRange(render_options,
+                                findRange(*concentration_values,
+                                          dataset.fillValue()));
+            }
+            auto png = renderPng(*concentration_values, x_values.size(),
+                                 y_values.size(), dataset.fillValue(),
+                                 render_options);
+            auto etag = makeETag(png);
+            auto rendered = std::make_shared<RenderedImage const>(
+                RenderedImage{std::move(png), std::move(etag)});
+            image_cache.put(key, rendered, rendered->png.size());
+            image = rendered;
           }
-          grid.push_back(row);
+        } catch (BadRequest const& e) {
+          result["error"] = e.what();
+          return crow::response(400, result.dump());
+        } catch (InternalServerError const& e) {
+          result["error"] = e.what();
+          return crow::response(500, result.dump());
         }
 
-        result["concentration_data"] = grid;
-        return crow::response(result.dump(2));
+        return imageResponse(*image, request);
       });
 
-  CROW_ROUTE(app, "/get-image")
-      .methods("GET"_method)([&nc_file](crow::request const& request) {
+  CROW_ROUTE(app, "/tiles/<uint>/<uint>/<uint>/<uint>/<string>")
+      .methods("GET"_method)([&dataset, &stats_index, &pyramid_cache,
+                              &tile_cache](crow::request const& request,
+                                           std::uint64_t t_index,
+                                           std::uint64_t z_index,
+                                           std::uint64_t level,
+                                           std::uint64_t tx,
+                                           std::string const& ty_file) {
         auto result = json();
-        auto grid_data = GridData{};
+        auto image = std::shared_ptr<RenderedImage const>{};
         try {
-          grid_data = getGridData(nc_file, request);
+          // the last path segment is the tile row followed by ".png"
+          auto ty = std::uint64_t{};
+          auto ty_text = std::string_view{ty_file};
+          auto suffix = std::string_view{".png"};
+          if (ty_text.size() <= suffix.size() or
+              ty_text.substr(ty_text.size() - suffix.size()) != suffix) {
+            throw NotFound("Tiles are named {ty}.png.");
+          }
+          ty_text.remove_suffix(suffix.size());
+          auto [end, ec] = std::from_chars(
+              ty_text.data(), ty_text.data() + ty_text.size(), ty);
+          if (ec != std::errc{} or end != ty_text.data() + ty_text.size()) {
+            throw NotFound("Tiles are named {ty}.png.");
+          }
+          if (t_index >= dataset.timeSize()) {
+            throw BadRequest("t index is out of bounds.");
+          }
+          if (z_index >= dataset.zSize()) {
+            throw BadRequest("z index is out of bounds.");
+          }
+
+          // every tile of a slice shares the color range of the whole slice
+          auto selection =
+              SliceSelection{t_index, z_index, dataset.fullWindow()};
+          auto render_options =
+              getColorOptions(stats_index, selection, request);
+          // tile padding is transparent
+          render_options.alpha = true;
+          if (not render_options.vmin or not render_options.vmax) {
+            auto stats = stats_index.stats(t_index, z_index);
+            resolveColorRange(render_options, {stats->min, stats->max});
+          }
+          auto key = imageCacheKey(selection, render_options) + "&tile=" +
+                     std::to_string(level) + "/" + std::to_string(tx) + "/" +
+                     std::to_string(ty);
+          image = tile_cache.get(key);
+          if (not image) {
+            auto pyramid =
+                getPyramid(dataset, pyramid_cache, t_index, z_index);
+            if (not pyramid->contains(level, tx, ty)) {
+              throw NotFound("Tile is outside the slice.");
+            }
+            auto png = renderPng(pyramid->tile(level, tx, ty), kTileSize,
+                                 kTileSize, dataset.fillValue(),
+                                 render_options);
+            auto etag = makeETag(png);
+            auto rendered = std::make_shared<RenderedImage const>(
+                RenderedImage{std::move(png), std::move(etag)});
+            tile_cache.put(key, rendered, rendered->png.size());
+            image = rendered;
+          }
+        } catch (BadRequest const& e) {
+          result["error"] = e.what();
+          return crow::response(400, result.dump());
+        } catch (NotFound const& e) {
+          result["error"] = e.what();
+          return crow::response(404, result.dump());
+        } catch (InternalServerError const& e) {
+          result["error"] = e.what();
+          return crow::response(500, result.dump());
+        }
+        return imageResponse(*image, request);
+      });
+
+  CROW_ROUTE(app, "/get-animation")
+      .methods("GET"_method)([&dataset, &image_cache, &stats_index,
+                              &options](crow::request const& request) {
+        auto result = json();
+        auto image = std::shared_ptr<RenderedImage const>{};
+        try {
+          auto selection =
+              getAnimationSelection(dataset, stats_index, request);
+          auto key = animationCacheKey(selection);
+          image = image_cache.get(key);
+          if (not image) {
+            auto rendered = std::make_shared<RenderedImage const>(
+                renderAnimation(dataset, selection, options->thread_count));
+            image_cache.put(key, rendered, rendered->png.size());
+            image = rendered;
+          }
+        } catch (BadRequest const& e) {
+          result["error"] = e.what();
+          return crow::response(400, result.dump());
+        } catch (InternalServerError const& e) {
+          result["error"] = e.what();
+          return crow::response(500, result.dump());
+        }
+        return imageResponse(*image, request);
+      });
+
+  CROW_ROUTE(app, "/get-series")
+      .methods("GET"_method)([&dataset, &series_index,
+                              &options](crow::request const& request) {
+        auto result = json();
+        auto x_index = std::size_t{};
+        auto y_index = std::size_t{};
+        auto z_index = std::size_t{};
+        auto series = std::vector<double>{};
+        try {
+          for (auto name : {"x", "y", "z"}) {
+            if (not request.url_params.get(name)) {
+              throw BadRequest(std::string{"Missing query parameter '"} +
+                               name + "'.");
+            }
+          }
+          x_index = parseIndex(request, "x", 0);
+          y_index = parseIndex(request, "y", 0);
+          z_index = parseIndex(request, "z", 0);
+          if (x_index >= dataset.xSize()) {
+            throw BadRequest("x index is out of bounds.");
+          }
+          if (y_index >= dataset.ySize()) {
+            throw BadRequest("y index is out of bounds.");
+          }
+          if (z_index >= dataset.zSize()) {
+            throw BadRequest("z index is out of bounds.");
+          }
+          series = series_index.series(x_index, y_index, z_index);
         } catch (BadRequest const& e) {
           result["error"] = e.what();
           return crow::response(400, result.dump());
@@ -153,94 +793,1306 @@ int main(int argc, char* argv[]) {
           result["error"] = e.what();
           return crow::response(500, result.dump());
         }
-        auto const& [x_values, y_values, concentration_data] = grid_data;
-        auto row_size = x_values.size();
-        auto col_size = y_values.size();
-
-        // color range
-        auto min_value = *std::min_element(concentration_data.begin(),
-                                           concentration_data.end());
-        auto max_value = *std::max_element(concentration_data.begin(),
-                                           concentration_data.end());
-        auto value_range = max_value - min_value;
-
-        // compute pixel values
-        auto image = std::vector<uint8_t>(row_size * col_size);
-        for (std::size_t i = 0; i < concentration_data.size(); ++i) {
-          image[i] = static_cast<uint8_t>(
-              std::numeric_limits<uint8_t>::max() *
-              ((concentration_data[i] - min_value) / value_range));
-        }
-
-        // encode PNG
-        auto png = std::vector<uint8_t>{};
-        stbi_write_png_to_func(
-            [](void* context, void* data, int size) {
-              auto* buffer = static_cast<std::vector<uint8_t>*>(context);
-              buffer->insert(buffer->end(), static_cast<uint8_t*>(data),
-                             static_cast<uint8_t*>(data) + size);
-            },
-            &png, row_size, col_size, 1, image.data(), row_size);
 
         auto response = crow::response{};
-        response.set_header("Content-Type", "image/png");
-        response.body = std::string(png.begin(), png.end());
-        response.code = 200;  // successful
+        auto body =
+            ResponseBody{acceptedEncoding(request), options->compression};
+        auto writer = JsonWriter{body.text()};
+        writer.beginObject();
+        writer.key("x");
+        writer.value(dataset.xValues()[x_index]);
+        writer.key("y");
+        writer.value(dataset.yValues()[y_index]);
+        writer.key("z_index");
+        writer.value(z_index);
+        writer.key("concentration");
+        writer.beginArray();
+        for (auto concentration : series) {
+          writer.value(concentration);
+        }
+        writer.endArray();
+        writer.endObject();
+        body.finish(response);
         return response;
       });
 
-  app.port(18080).run();
+  CROW_ROUTE(app, "/get-value")
+      .methods("GET"_method)([&dataset](crow::request const& request) {
+        auto result = json();
+        auto x = 0.0;
+        auto y = 0.0;
+        auto t_index = std::size_t{};
+        auto z_index = std::size_t{};
+        auto value = 0.0;
+        try {
+          for (auto name : {"x", "y", "z"}) {
+            if (not request.url_params.get(name)) {
+              throw BadRequest(std::string{"Missing query parameter '"} +
+                               name + "'.");
+            }
+          }
+          x = *parseNumber(request, "x");
+          y = *parseNumber(request, "y");
+          t_index = getTimeIndex(dataset, request);
+          z_index = parseIndex(request, "z", 0);
+          if (z_index >= dataset.zSize()) {
+            throw BadRequest("z index is out of bounds.");
+          }
+          value = readValue(dataset, t_index, z_index,
+                            locatePoint(dataset, x, y));
+        } catch (BadRequest const& e) {
+          result["error"] = e.what();
+          return crow::response(400, result.dump());
+        } catch (InternalServerError const& e) {
+          result["error"] = e.what();
+          return crow::response(500, result.dump());
+        }
+
+        auto body = std::string{};
+        auto writer = JsonWriter{body};
+        writer.beginObject();
+        writer.key("x");
+        writer.value(x);
+        writer.key("y");
+        writer.value(y);
+        writer.key("t_index");
+        writer.value(t_index);
+        writer.key("z_index");
+        writer.value(z_index);
+        writer.key("concentration");
+        writer.value(value);
+        writer.endObject();
+        return crow::response(body);
+      });
+
+  CROW_ROUTE(app, "/sample")
+      .methods("POST"_method)([&dataset,
+                               &options](crow::request const& request) {
+        auto result = json();
+        auto values = std::vector<double>{};
+        try {
+          values = samplePoints(dataset, getSamplePoints(dataset, request));
+        } catch (BadRequest const& e) {
+          result["error"] = e.what();
+          return crow::response(400, result.dump());
+        } catch (InternalServerError const& e) {
+          result["error"] = e.what();
+          return crow::response(500, result.dump());
+        }
+
+        auto response = crow::response{};
+        auto body =
+            ResponseBody{acceptedEncoding(request), options->compression};
+        auto writer = JsonWriter{body.text()};
+        writer.beginObject();
+        writer.key("concentration");
+        writer.beginArray();
+        for (auto value : values) {
+          writer.value(value);
+          body.flush();
+        }
+        writer.endArray();
+        writer.endObject();
+        body.finish(response);
+        return response;
+      });
+
+  CROW_ROUTE(app, "/get-stats")
+      .methods("GET"_method)([&dataset,
+                              &stats_index](crow::request const& request) {
+        auto result = json();
+        auto selection = SliceSelection{};
+        auto stats = std::shared_ptr<SliceStats const>{};
+        try {
+          selection = getSliceSelection(dataset, request);
+          stats = stats_index.stats(selection.t_index, selection.z_index);
+        } catch (BadRequest const& e) {
+          result["error"] = e.what();
+          return crow::response(400, result.dump());
+        } catch (InternalServerError const& e) {
+          result["error"] = e.what();
+          return crow::response(500, result.dump());
+        }
+
+        auto body = std::string{};
+        auto writer = JsonWriter{body, 2};
+        writer.beginObject();
+        writer.key("t_index");
+        writer.value(selection.t_index);
+        writer.key("z_index");
+        writer.value(selection.z_index);
+        writer.key("min");
+        writer.value(stats->min);
+        writer.key("max");
+        writer.value(stats->max);
+        writer.key("mean");
+        writer.value(stats->mean);
+        writer.key("stddev");
+        writer.value(stats->stddev);
+        writer.key("count");
+        writer.value(stats->count);
+        writer.key("nan_count");
+        writer.value(stats->missing_count);
+        writer.key("histogram");
+        writer.beginArray();
+        for (auto bin_count : stats->histogram) {
+          writer.value(bin_count);
+        }
+        writer.endArray();
+        writer.endObject();
+        return crow::response(body);
+      });
+
+  CROW_ROUTE(app, "/get-cache-stats")([&dataset, &image_cache, &pyramid_cache,
+                                       &tile_cache] {
+    auto to_json = [](auto const& stats) {
+      auto result = json{};
+      result["hits"] = stats.hits;
+      result["misses"] = stats.misses;
+      result["evictions"] = stats.evictions;
+      result["entries"] = stats.entries;
+      result["bytes"] = stats.bytes;
+      result["capacity_bytes"] = stats.capacity_bytes;
+      return result;
+    };
+    auto result = json{};
+    result["slices"] = to_json(dataset.sliceCacheStats());
+    result["images"] = to_json(image_cache.stats());
+    result["pyramids"] = to_json(pyramid_cache.stats());
+    result["tiles"] = to_json(tile_cache.stats());
+    return crow::response(result.dump(2));
+  });
+
+  // file access is serialized by the dataset, so handlers may run on any
+  // number of worker threads
+  app.port(18080).concurrency(options->thread_count).run();
 }
 
-GridData getGridData(netCDF::NcFile const& nc_file,
-                     crow::request const& request) {
-  // parse t and z index parameters
-  char const* t_param = request.url_params.get("t");
-  if (not t_param) {
-    throw BadRequest("Missing query parameter 't'.");
+std::optional<Options> parseOptions(int argc, char* argv[]) {
+  auto options = Options{};
+  auto have_filename = false;
+
+  // reads the value following an option as an integer no smaller than
+  // min_value
+  auto next_integer = [&](int& i, int min_value) -> std::optional<int> {
+    if (++i == argc) {
+      return std::nullopt;
+    }
+    try {
+      auto value = std::stoi(argv[i]);
+      if (value < min_value) {
+        return std::nullopt;
+      }
+      return value;
+    } catch (std::exception const&) {
+      return std::nullopt;
+    }
+  };
+
+  for (int i = 1; i < argc; ++i) {
+    auto arg = std::string{argv[i]};
+    if (arg == "--cache-mb") {
+      auto value = next_integer(i, 0);
+      if (not value) {
+        return std::nullopt;
+      }
+      options.slice_cache_mb = static_cast<std::size_t>(*value);
+    } else if (arg == "--image-cache-mb") {
+      auto value = next_integer(i, 0);
+      if (not value) {
+        return std::nullopt;
+      }
+      options.image_cache_mb = static_cast<std::size_t>(*value);
+    } else if (arg == "--pyramid-cache-mb") {
+      auto value = next_integer(i, 0);
+      if (not value) {
+        return std::nullopt;
+      }
+      options.pyramid_cache_mb = static_cast<std::size_t>(*value);
+    } else if (arg == "--tile-cache-mb") {
+      auto value = next_integer(i, 0);
+      if (not value) {
+        return std::nullopt;
+      }
+      options.tile_cache_mb = static_cast<std::size_t>(*value);
+    } else if (arg == "--series-index") {
+      if (++i == argc) {
+        return std::nullopt;
+      }
+      auto mode = std::string{argv[i]};
+      if (mode == "off") {
+        options.series_index = SeriesIndex::Mode::Off;
+      } else if (mode == "lazy") {
+        options.series_index = SeriesIndex::Mode::Lazy;
+      } else if (mode == "startup") {
+        options.series_index = SeriesIndex::Mode::Startup;
+      } else {
+        return std::nullopt;
+      }
+    } else if (arg == "--stats-index") {
+      if (++i == argc) {
+        return std::nullopt;
+      }
+      auto mode = std::string{argv[i]};
+      if (mode == "lazy") {
+        options.stats_index = StatsIndex::Mode::Lazy;
+      } else if (mode == "background") {
+        options.stats_index = StatsIndex::Mode::Background;
+      } else {
+        return std::nullopt;
+      }
+    } else if (arg == "--series-index-mb") {
+      auto value = next_integer(i, 0);
+      if (not value) {
+        return std::nullopt;
+      }
+      options.series_index_mb = static_cast<std::size_t>(*value);
+    } else if (arg == "--compression-level") {
+      auto value = next_integer(i, 0);
+      if (not value or *value > 9) {
+        return std::nullopt;
+      }
+      options.compression.level = *value;
+    } else if (arg == "--compression-min-bytes") {
+      auto value = next_integer(i, 0);
+      if (not value) {
+        return std::nullopt;
+      }
+      options.compression.min_size = static_cast<std::size_t>(*value);
+    } else if (arg == "--threads") {
+      auto value = next_integer(i, 1);
+      if (not value) {
+        return std::nullopt;
+      }
+      options.thread_count = static_cast<unsigned>(*value);
+    } else if (not have_filename and not arg.empty() and arg[0] != '-') {
+      options.nc_filename = arg;
+      have_filename = true;
+    } else {
+      return std::nullopt;
+    }
+  }
+  if (not have_filename) {
+    return std::nullopt;
+  }
+  return options;
+}
+
+json getInfo(Dataset const& dataset) {
+  auto lock = dataset.lockFile();
+  auto const& nc_file = dataset.file();
+
+  // dimensions
+  auto dims = json::object();
+  for (auto const& [dim_name, dim] : nc_file.getDims()) {
+    dims[dim_name] = dim.getSize();
+  }
+
+  // variables
+  auto vars = json::object();
+  for (auto const& [var_name, var] : nc_file.getVars()) {
+    auto var_info = json{};
+    var_info["type"] = var.getType().getName();
+
+    auto dim_names = std::vector<std::string>{};
+    for (auto const& dim : var.getDims()) {
+      dim_names.push_back(dim.getName());
+    }
+    var_info["dimensions"] = dim_names;
+
+    auto attributes = json::object();
+    for (auto const& [attribute_name, attribute] : var.getAtts()) {
+      // text as a string; numbers (e.g. _FillValue, valid_range) as a number
+      // or an array, since getValues(std::string&) throws for them
+      auto type = attribute.getType().getTypeClass();
+      if (type == netCDF::NcType::nc_CHAR or
+          type == netCDF::NcType::nc_STRING) {
+        auto value = std::string{};
+        attribute.getValues(value);
+        attributes[attribute_name] = value;
+        continue;
+      }
+      auto values = std::vector<double>(attribute.getAttLength());
+      attribute.getValues(values.data());
+      if (values.size() == 1) {
+        attributes[attribute_name] = values.front();
+      } else {
+        attributes[attribute_name] = values;
+      }
+    }
+    var_info["attributes"] = attributes;
+
+    vars[var_name] = var_info;
   }
-  char const* z_param = request.url_params.get("z");
-  if (not z_param) {
+
+  // result
+  auto result = json{};
+  result["dimensions"] = dims;
+  result["variables"] = vars;
+  return result;
+}
+
+SliceSelection getSliceSelection(Dataset const& dataset,
+                                 crow::request const& request) {
+  // parse t (or time) and z index parameters
+  auto t_index = getTimeIndex(dataset, request);
+  if (not request.url_params.get("z")) {
     throw BadRequest("Missing query parameter 'z'.");
   }
-  auto t_index = static_cast<std::size_t>(std::stoi(t_param));
-  auto z_index = static_cast<std::size_t>(std::stoi(z_param));
+  auto z_index = parseIndex(request, "z", 0);
 
   // check parameter bounds
-  auto t_size = nc_file.getDim("time").getSize();
-  if (t_index >= t_size) {
+  if (z_index >= dataset.zSize()) {
+    throw BadRequest("z index is out of bounds.");
+  }
+
+  return {t_index, z_index, getWindow(dataset, request)};
+}
+
+std::size_t getTimeIndex(Dataset const& dataset, crow::request const& request) {
+  char const* time_param = request.url_params.get("time");
+  if (request.url_params.get("t") and time_param) {
+    throw BadRequest("Use either t or time, not both.");
+  }
+  if (time_param) {
+    return findTimeIndex(dataset, std::string{time_param});
+  }
+  if (not request.url_params.get("t")) {
+    throw BadRequest("Missing query parameter 't'.");
+  }
+  auto t_index = parseIndex(request, "t", 0);
+  if (t_index >= dataset.timeSize()) {
     throw BadRequest("t index is out of bounds.");
   }
-  auto z_size = nc_file.getDim("z").getSize();
-  if (z_index >= z_size) {
+  return t_index;
+}
+
+std::size_t findTimeIndex(Dataset const& dataset, std::string const& time) {
+  if (dataset.timeAxis().values().empty()) {
+    throw BadRequest("The file has no ascending time coordinate; use t.");
+  }
+
+  // a plain number is a value of the time coordinate
+  char* end = nullptr;
+  auto time_value = std::strtod(time.c_str(), &end);
+  if (not time.empty() and *end == '\0') {
+    return findTimeIndex(dataset, time_value);
+  }
+
+  auto date = parseDateTime(time);
+  if (not date) {
+    throw BadRequest("time must be an ISO 8601 date and time or a number.");
+  }
+  auto const& time_axis = dataset.timeAxis();
+  if (not time_axis.hasDates()) {
+    throw BadRequest("The time coordinate has no units to convert dates.");
+  }
+  auto value = time_axis.valueOf(*date);
+  if (not value) {
+    throw BadRequest("time is not a date in the calendar of the file.");
+  }
+  return findTimeIndex(dataset, *value);
+}
+
+std::size_t findTimeIndex(Dataset const& dataset, double time_value) {
+  if (dataset.timeAxis().values().empty()) {
+    throw BadRequest("The file has no ascending time coordinate; use t.");
+  }
+  auto t_index = dataset.timeAxis().find(time_value);
+  if (not t_index) {
+    throw BadRequest("time is outside the time coordinate.");
+  }
+  return *t_index;
+}
+
+Window getWindow(Dataset const& dataset, crow::request const& request) {
+  auto x_size = dataset.xSize();
+  auto y_size = dataset.ySize();
+  auto has_index_range = request.url_params.get("x0") or
+                         request.url_params.get("x1") or
+                         request.url_params.get("y0") or
+                         request.url_params.get("y1");
+  char const* bbox_param = request.url_params.get("bbox");
+  if (has_index_range and bbox_param) {
+    throw BadRequest("Use either index ranges or bbox, not both.");
+  }
+
+  // every stride-th point along both axes, for overview resolutions
+  auto stride = parseIndex(request, "stride", 1);
+  if (stride == 0) {
+    throw BadRequest("stride must be positive.");
+  }
+  // any longer stride samples the same single point, and the hyperslab
+  // stride has to fit a signed offset
+  stride = std::min(stride, std::max(x_size, y_size));
+  // points sampled from a non-empty range [first, last)
+  auto strided = [stride](std::size_t first, std::size_t last) {
+    return (last - first - 1) / stride + 1;
+  };
+
+  if (bbox_param) {
+    // xmin,ymin,xmax,ymax in coordinate values
+    auto bounds = parseNumberList(bbox_param, "bbox");
+    if (bounds.size() != 4) {
+      throw BadRequest("bbox must be 'xmin,ymin,xmax,ymax'.");
+    }
+    auto [x_first, x_last] =
+        coordinateRange(dataset.xValues(), bounds[0], bounds[2]);
+    auto [y_first, y_last] =
+        coordinateRange(dataset.yValues(), bounds[1], bounds[3]);
+    if (x_first == x_last or y_first == y_last) {
+      throw BadRequest("bbox does not contain any grid points.");
+    }
+    return {y_first, strided(y_first, y_last), x_first,
+            strided(x_first, x_last), stride};
+  }
+
+  // half-open index ranges [x0, x1) and [y0, y1)
+  auto x0 = parseIndex(request, "x0", 0);
+  auto x1 = parseIndex(request, "x1", x_size);
+  auto y0 = parseIndex(request, "y0", 0);
+  auto y1 = parseIndex(request, "y1", y_size);
+  if (x1 > x_size or y1 > y_size) {
+    throw BadRequest("x/y index range is out of bounds.");
+  }
+  if (x0 >= x1 or y0 >= y1) {
+    throw BadRequest("x/y index range is empty.");
+  }
+  return {y0, strided(y0, y1), x0, strided(x0, x1), stride};
+}
+
+std::size_t parseIndex(crow::request const& request, char const* name,
+                       std::size_t default_value) {
+  char const* param = request.url_params.get(name);
+  if (not param) {
+    return default_value;
+  }
+  auto text = std::string_view{param};
+  auto value = std::size_t{};
+  auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(),
+                                   value);
+  if (ec != std::errc{} or end != text.data() + text.size()) {
+    throw BadRequest(std::string{"Query parameter '"} + name +
+                     "' must be a non-negative integer.");
+  }
+  return value;
+}
+
+std::optional<double> parseNumber(crow::request const& request,
+                                  char const* name) {
+  char const* param = request.url_params.get(name);
+  if (not param) {
+    return std::nullopt;
+  }
+  char* end = nullptr;
+  auto number = std::strtod(param, &end);
+  if (*param == '\0' or *end != '\0' or not std::isfinite(number)) {
+    throw BadRequest(std::string{"Query parameter '"} + name +
+                     "' must be a number.");
+  }
+  return number;
+}
+
+std::vector<double> parseNumberList(std::string const& text,
+                                    char const* name) {
+  auto invalid = [name] {
+    return BadRequest(std::string{"Query parameter '"} + name +
+                      "' must be a comma-separated list of numbers.");
+  };
+  // getline yields no empty field after a trailing comma
+  if (text.empty() or text.back() == ',') {
+    throw invalid();
+  }
+  auto numbers = std::vector<double>{};
+  auto stream = std::istringstream{text};
+  auto item = std::string{};
+  while (std::getline(stream, item, ',')) {
+    char* end = nullptr;
+    auto number = std::strtod(item.c_str(), &end);
+    if (item.empty() or *end != '\0' or not std::isfinite(number)) {
+      throw invalid();
+    }
+    numbers.push_back(number);
+  }
+  return numbers;
+}
+
+GridData getGridData(Dataset const& dataset, SliceSelection const& selection) {
+  // coordinates are cached by the dataset, so at most the window is read
+  auto grid_data = getGridCoordinates(dataset, selection.window);
+  grid_data.concentration_values = dataset.readWindow(
+      selection.t_index, selection.z_index, selection.window);
+  return grid_data;
+}
+
+GridData getGridCoordinates(Dataset const& dataset, Window const& window) {
+  auto sample = [&window](std::vector<double> const& values,
+                          std::size_t start, std::size_t count) {
+    auto sampled = std::vector<double>(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      sampled[i] = values[start + i * window.stride];
+    }
+    return sampled;
+  };
+  return {sample(dataset.xValues(), window.x_start, window.x_count),
+          sample(dataset.yValues(), window.y_start, window.y_count),
+          nullptr};
+}
+
+GridData getGridData(Dataset const& dataset, crow::request const& request) {
+  return getGridData(dataset, getSliceSelection(dataset, request));
+}
+
+GridPoint locatePoint(Dataset const& dataset, double x, double y) {
+  auto x_position = locateCoordinate(dataset.xValues(), x);
+  if (not x_position) {
+    throw BadRequest("x coordinate is outside the grid.");
+  }
+  auto y_position = locateCoordinate(dataset.yValues(), y);
+  if (not y_position) {
+    throw BadRequest("y coordinate is outside the grid.");
+  }
+  return {*x_position, *y_position};
+}
+
+double readValue(Dataset const& dataset, std::size_t t_index,
+                 std::size_t z_index, GridPoint const& point) {
+  // a point on a grid line needs no neighbour across it
+  auto window = Window{point.y.index, point.y.weight == 0.0 ? 1u : 2u,
+                       point.x.index, point.x.weight == 0.0 ? 1u : 2u};
+  auto values = dataset.readWindow(t_index, z_index, window);
+  return interpolateBilinear(values->data(), window.x_count,
+                             {0, point.x.weight}, {0, point.y.weight},
+                             dataset.fillValue());
+}
+
+std::vector<SamplePoint> getSamplePoints(Dataset const& dataset,
+                                         crow::request const& request) {
+  auto body = json{};
+  try {
+    body = json::parse(request.body);
+  } catch (json::exception const&) {
+    throw BadRequest("The request body must be JSON.");
+  }
+  if (not body.is_object() or not body.contains("points") or
+      not body["points"].is_array()) {
+    throw BadRequest("The request body must have a 'points' array.");
+  }
+  if (body["points"].size() > kMaxSamplePoints) {
+    throw BadRequest("A request can sample at most " +
+                     std::to_string(kMaxSamplePoints) + " points.");
+  }
+
+  auto points = std::vector<SamplePoint>{};
+  points.reserve(body["points"].size());
+  for (auto const& entry : body["points"]) {
+    if (not entry.is_object() or not entry.contains("x") or
+        not entry["x"].is_number() or not entry.contains("y") or
+        not entry["y"].is_number()) {
+      throw BadRequest(
+          "Each point must be an object with numbers 'x' and 'y'.");
+    }
+    auto t_index = std::size_t{};
+    if (entry.contains("t") and entry["t"].is_number_unsigned()) {
+      t_index = entry["t"].get<std::size_t>();
+    } else if (entry.contains("time") and entry["time"].is_string()) {
+      t_index = findTimeIndex(dataset, entry["time"].get<std::string>());
+    } else if (entry.contains("time") and entry["time"].is_number()) {
+      t_index = findTimeIndex(dataset, entry["time"].get<double>());
+    } else {
+      throw BadRequest("Each point needs a 't' index or a 'time'.");
+    }
+    auto z_index = std::size_t{};
+    if (entry.contains("z")) {
+      if (not entry["z"].is_number_unsigned()) {
+        throw BadRequest("'z' must be an index.");
+      }
+      z_index = entry["z"].get<std::size_t>();
+    }
+    if (t_index >= dataset.timeSize()) {
+      throw BadRequest("t index is out of bounds.");
+    }
+    if (z_index >= dataset.zSize()) {
+      throw BadRequest("z index is out of bounds.");
+    }
+
+    auto point = SamplePoint{std::nullopt, t_index, z_index};
+    auto x = locateCoordinate(dataset.xValues(), entry["x"].get<double>());
+    auto y = locateCoordinate(dataset.yValues(), entry["y"].get<double>());
+    if (x and y) {
+      point.point = GridPoint{*x, *y};
+    }
+    points.push_back(point);
+  }
+  return points;
+}
+
+std::vector<double> samplePoints(Dataset const& dataset,
+                                 std::vector<SamplePoint> const& points) {
+  auto values = std::vector<double>(points.size(),
+                                    std::numeric_limits<double>::quiet_NaN());
+
+  // visit the points inside the grid slice by slice
+  auto order = std::vector<std::size_t>{};
+  for (std::size_t i = 0; i < points.size(); ++i) {
+    if (points[i].point) {
+      order.push_back(i);
+    }
+  }
+  auto slice_of = [&points](std::size_t i) {
+    return std::pair{points[i].t_index, points[i].z_index};
+  };
+  std::stable_sort(order.begin(), order.end(),
+                   [&](auto a, auto b) { return slice_of(a) < slice_of(b); });
+
+  for (auto group = order.begin(); group != order.end();) {
+    auto group_end = std::find_if(group, order.end(), [&](auto i) {
+      return slice_of(i) != slice_of(*group);
+    });
+
+    // the bounding box of the points and the grid points they draw on
+    auto y_first = dataset.ySize();
+    auto y_last = std::size_t{};
+    auto x_first = dataset.xSize();
+    auto x_last = std::size_t{};
+    for (auto it = group; it != group_end; ++it) {
+      auto const& point = *points[*it].point;
+      y_first = std::min(y_first, point.y.index);
+      y_last = std::max(y_last, point.y.index + (point.y.weight != 0.0));
+      x_first = std::min(x_first, point.x.index);
+      x_last = std::max(x_last, point.x.index + (point.x.weight != 0.0));
+    }
+    auto window = Window{y_first, y_last - y_first + 1, x_first,
+                         x_last - x_first + 1};
+    auto [t_index, z_index] = slice_of(*group);
+    auto slice = dataset.readWindow(t_index, z_index, window);
+
+    for (auto it = group; it != group_end; ++it) {
+      auto const& point = *points[*it].point;
+      values[*it] = interpolateBilinear(
+          slice->data(), window.x_count,
+          {point.x.index - x_first, point.x.weight},
+          {point.y.index - y_first, point.y.weight}, dataset.fillValue());
+    }
+    group = group_end;
+  }
+  return values;
+}
+
+RenderOptions getColorOptions(StatsIndex const& stats_index,
+                              SliceSelection const& selection,
+                              crow::request const& request) {
+  auto options = RenderOptions{};
+  if (char const* cmap_param = request.url_params.get("cmap")) {
+    auto colormap = parseColormap(cmap_param);
+    if (not colormap) {
+      throw BadRequest(
+          "cmap must be one of gray, viridis, magma or diverging.");
+    }
+    options.colormap = *colormap;
+  }
+  options.vmin = parseNumber(request, "vmin");
+  options.vmax = parseNumber(request, "vmax");
+  if (options.vmin and options.vmax and *options.vmin >= *options.vmax) {
+    throw BadRequest("vmin must be less than vmax.");
+  }
+
+  auto scale = std::string{"slice"};
+  if (char const* scale_param = request.url_params.get("scale")) {
+    scale = scale_param;
+  }
+  auto range = std::optional<ValueRange>{};
+  if (scale == "level") {
+    range = stats_index.levelRange(selection.z_index);
+  } else if (scale == "global") {
+    range = stats_index.variableRange();
+  } else if (scale != "slice") {
+    throw BadRequest("scale must be one of slice, level or global.");
+  }
+  if (range) {
+    resolveColorRange(options, *range);
+  }
+  return options;
+}
+
+void resolveColorRange(RenderOptions& options, ValueRange range) {
+  auto has_vmin = options.vmin.has_value();
+  auto has_vmax = options.vmax.has_value();
+  // a NaN extremum (no values at all) leaves the bound open
+  if (not has_vmin and not std::isnan(range.min)) {
+    options.vmin = range.min;
+  }
+  if (not has_vmax and not std::isnan(range.max)) {
+    options.vmax = range.max;
+  }
+  if (has_vmin != has_vmax and options.vmin and options.vmax and
+      *options.vmin >= *options.vmax) {
+    throw BadRequest(has_vmin ? "vmin must be less than the largest value."
+                              : "vmax must be greater than the smallest "
+                                "value.");
+  }
+}
+
+RenderOptions getRenderOptions(StatsIndex const& stats_index,
+                               SliceSelection const& selection,
+                               crow::request const& request) {
+  auto options = getColorOptions(stats_index, selection, request);
+
+  // output size, in pixels
+  auto src_width = selection.window.x_count;
+  auto src_height = selection.window.y_count;
+  auto has_size =
+      request.url_params.get("width") or request.url_params.get("height");
+  if (has_size and request.url_params.get("zoom")) {
+    throw BadRequest("Use either width and height or zoom, not both.");
+  }
+  if (has_size) {
+    options.width = parseIndex(request, "width", 0);
+    options.height = parseIndex(request, "height", 0);
+    if ((request.url_params.get("width") and options.width == 0) or
+        (request.url_params.get("height") and options.height == 0)) {
+      throw BadRequest("width and height must be positive.");
+    }
+    // keep the aspect ratio of the data for the missing dimension
+    if (options.height == 0) {
+      options.height = std::max<std::size_t>(
+          1, std::lround(static_cast<double>(options.width) * src_height /
+                         src_width));
+    } else if (options.width == 0) {
+      options.width = std::max<std::size_t>(
+          1, std::lround(static_cast<double>(options.height) * src_width /
+                         src_height));
+    }
+  } else if (request.url_params.get("zoom")) {
+    auto zoom = parseIndex(request, "zoom", 1);
+    if (zoom == 0) {
+      throw BadRequest("zoom must be positive.");
+    }
+    if (zoom > kMaxImagePixels) {
+      throw BadRequest("The requested image is too large.");
+    }
+    options.width = src_width * zoom;
+    options.height = src_height * zoom;
+  }
+  auto out_width = options.width > 0 ? options.width : src_width;
+  auto out_height = options.height > 0 ? options.height : src_height;
+  if (out_width > kMaxImagePixels or out_height > kMaxImagePixels or
+      out_width * out_height > kMaxImagePixels) {
+    throw BadRequest("The requested image is too large; the limit is " +
+                     std::to_string(kMaxImagePixels) + " pixels.");
+  }
+
+  if (char const* resample_param = request.url_params.get("resample")) {
+    auto resampling = parseResampling(resample_param);
+    if (not resampling) {
+      throw BadRequest("resample must be nearest or bilinear.");
+    }
+    options.resampling = *resampling;
+  }
+  return options;
+}
+
+std::string imageCacheKey(SliceSelection const& selection,
+                          RenderOptions const& render_options) {
+  auto const& window = selection.window;
+  auto key = "t=" + std::to_string(selection.t_index) +
+             "&z=" + std::to_string(selection.z_index) + "&y=" +
+             std::to_string(window.y_start) + "+" +
+             std::to_string(window.y_count) + "&x=" +
+             std::to_string(window.x_start) + "+" +
+             std::to_string(window.x_count) +
+             "&stride=" + std::to_string(window.stride);
+  key += "&cmap=";
+  key += colormapName(render_options.colormap);
+  // hex floats round-trip exactly
+  auto bound = [&key](char const* name, std::optional<double> value) {
+    if (value) {
+      char text[32];
+      std::snprintf(text, sizeof(text), "%a", *value);
+      key += std::string{"&"} + name + "=" + text;
+    }
+  };
+  bound("vmin", render_options.vmin);
+  bound("vmax", render_options.vmax);
+  if (render_options.width > 0) {
+    key += "&size=" + std::to_string(render_options.width) + "x" +
+           std::to_string(render_options.height);
+    key += "&resample=";
+    key += resamplingName(render_options.resampling);
+  }
+  return key;
+}
+
+std::shared_ptr<TilePyramid const> getPyramid(Dataset const& dataset,
+                                              PyramidCache& pyramid_cache,
+                                              std::size_t t_index,
+                                              std::size_t z_index) {
+  auto key = SliceKey{"concentration", t_index, z_index};
+  if (auto cached = pyramid_cache.get(key)) {
+    return cached;
+  }
+  auto pyramid = std::make_shared<TilePyramid const>(
+      *dataset.readSlice(t_index, z_index), dataset.xSize(), dataset.ySize(),
+      dataset.fillValue());
+  pyramid_cache.put(key, pyramid, pyramid->bytes());
+  return pyramid;
+}
+
+RangeSelection getRangeSelection(Dataset const& dataset,
+                                 crow::request const& request) {
+  for (auto name : {"t0", "t1", "z"}) {
+    if (not request.url_params.get(name)) {
+      throw BadRequest(std::string{"Missing query parameter '"} + name +
+                       "'.");
+    }
+  }
+  auto selection = RangeSelection{};
+  selection.t0 = parseIndex(request, "t0", 0);
+  selection.t1 = parseIndex(request, "t1", 0);
+  selection.z_index = parseIndex(request, "z", 0);
+  if (selection.t1 >= dataset.timeSize()) {
+    throw BadRequest("t1 index is out of bounds.");
+  }
+  if (selection.t0 > selection.t1) {
+    throw BadRequest("t0 must not be greater than t1.");
+  }
+  if (selection.z_index >= dataset.zSize()) {
     throw BadRequest("z index is out of bounds.");
   }
+  selection.window = getWindow(dataset, request);
+  return selection;
+}
+
+AnimationSelection getAnimationSelection(Dataset const& dataset,
+                                         StatsIndex const& stats_index,
+                                         crow::request const& request) {
+  auto selection =
+      AnimationSelection{getRangeSelection(dataset, request), {}, 0, false};
+  auto frame_count = selection.t1 - selection.t0 + 1;
+  if (frame_count > kMaxAnimationFrames) {
+    throw BadRequest("An animation can have at most " +
+                     std::to_string(kMaxAnimationFrames) + " frames.");
+  }
+
+  auto first_frame =
+      SliceSelection{selection.t0, selection.z_index, selection.window};
+  auto& render_options = selection.render_options;
+  render_options = getRenderOptions(stats_index, first_frame, request);
+  auto frame_width = render_options.width > 0 ? render_options.width
+                                              : selection.window.x_count;
+  auto frame_height = render_options.height > 0 ? render_options.height
+                                                : selection.window.y_count;
+  if (frame_width * frame_height * frame_count > kMaxAnimationPixels) {
+    throw BadRequest("The requested animation is too large; the limit is " +
+                     std::to_string(kMaxAnimationPixels) +
+                     " pixels over all frames.");
+  }
+  auto shared_range = not request.url_params.get("scale") and
+                      not (render_options.vmin and render_options.vmax);
+  // slice statistics only describe the window if it is the whole slice
+  selection.frame_range =
+      shared_range and not (selection.window == dataset.fullWindow());
+  if (shared_range and not selection.frame_range) {
+    auto min_value = std::numeric_limits<double>::quiet_NaN();
+    auto max_value = std::numeric_limits<double>::quiet_NaN();
+    for (auto t_index = selection.t0; t_index <= selection.t1; ++t_index) {
+      auto stats = stats_index.stats(t_index, selection.z_index);
+      min_value = std::fmin(min_value, stats->min);
+      max_value = std::fmax(max_value, stats->max);
+    }
+    resolveColorRange(render_options, {min_value, max_value});
+  }
+  // every frame needs the color type of the first
+  render_options.alpha = true;
+
+  auto delay = parseIndex(request, "delay", 200);
+  if (delay == 0 or delay > 65535) {
+    throw BadRequest("delay must be between 1 and 65535 milliseconds.");
+  }
+  selection.delay_ms = static_cast<unsigned>(delay);
+  return selection;
+}
+
+std::string animationCacheKey(AnimationSelection const& selection) {
+  return "animation:" +
+         imageCacheKey(SliceSelection{selection.t0, selection.z_index,
+                                      selection.window},
+                       selection.render_options) +
+         "&t1=" + std::to_string(selection.t1) +
+         "&delay=" + std::to_string(selection.delay_ms);
+}
+
+RenderedImage renderAnimation(Dataset const& dataset,
+                              AnimationSelection const& selection,
+                              unsigned thread_count) {
+  auto frames = std::vector<std::string>(selection.t1 - selection.t0 + 1);
+  auto render_options = selection.render_options;
+  if (selection.frame_range) {
+    auto ranges = std::vector<ValueRange>(frames.size());
+    parallelFor(frames.size(), thread_count, [&](std::size_t i) {
+      auto values = dataset.readWindow(selection.t0 + i, selection.z_index,
+                                       selection.window);
+      ranges[i] = findRange(*values, dataset.fillValue());
+    });
+    // fmin and fmax skip the NaN extrema of windows with no values
+    auto range = ValueRange{std::numeric_limits<double>::quiet_NaN(),
+                            std::numeric_limits<double>::quiet_NaN()};
+    for (auto const& frame_range : ranges) {
+      range.min = std::fmin(range.min, frame_range.min);
+      range.max = std::fmax(range.max, frame_range.max);
+    }
+    resolveColorRange(render_options, range);
+  }
+  parallelFor(frames.size(), thread_count, [&](std::size_t i) {
+    auto grid_data = getGridData(
+        dataset, SliceSelection{selection.t0 + i, selection.z_index,
+                                selection.window});
+    // with scale=slice, each frame takes the range of its own values
+    auto frame_options = render_options;
+    if (not frame_options.vmin or not frame_options.vmax) {
+      resolveColorRange(frame_options,
+                        findRange(*grid_data.concentration_values,
+                                  dataset.fillValue()));
+    }
+    frames[i] = renderPng(*grid_data.concentration_values,
+                          grid_data.x_values.size(), grid_data.y_values.size(),
+                          dataset.fillValue(), frame_options);
+  });
+  auto png = assembleApng(frames, selection.delay_ms);
+  auto etag = makeETag(png);
+  return {std::move(png), std::move(etag)};
+}
+
+crow::response imageResponse(RenderedImage const& image,
+                             crow::request const& request) {
+  // let clients and caches revalidate without a new body
+  auto response = crow::response{};
+  response.set_header("ETag", image.etag);
+  auto const& if_none_match = request.get_header_value("If-None-Match");
+  if (not if_none_match.empty() and etagMatches(if_none_match, image.etag)) {
+    response.code = 304;  // not modified
+    return response;
+  }
+  response.set_header("Content-Type", "image/png");
+  response.body = image.png;
+  response.code = 200;  // successful
+  return response;
+}
+
+void writeGridJsonAos(GridData const& grid_data, ResponseBody& body) {
+  auto const& [x_values, y_values, concentration_values] = grid_data;
+  auto const& concentration_data = *concentration_values;
+  auto row_size = x_values.size();
+  auto col_size = y_values.size();
+
+  // The layout matches what json::dump(2) would produce for the same
+  // document, without building one json object per grid cell. The body is
+  // flushed after every row, so a compressed response never holds the whole
+  // plain text.
+  auto writer = JsonWriter{body.text(), 2};
+  writer.beginObject();
+  writer.key("concentration_data");
+  writer.beginArray();
+  for (std::size_t row_idx = 0; row_idx < col_size; ++row_idx) {
+    writer.beginArray();
+    for (std::size_t col_idx = 0; col_idx < row_size; ++col_idx) {
+      // Array of structs is chosen for display purposes. Struct of arrays may
+      // be preferred if the purpose is to read the data into data structures.
+      writer.beginObject();
+      writer.key("concentration");
+      writer.value(concentration_data[row_idx * row_size + col_idx]);
+      writer.key("x");
+      writer.value(x_values[col_idx]);
+      writer.key("y");
+      writer.value(y_values[row_idx]);
+      writer.endObject();
+    }
+    writer.endArray();
+    body.flush();
+  }
+  writer.endArray();
+  writer.endObject();
+}
+
+void writeGridJsonSoa(GridData const& grid_data, ResponseBody& body) {
+  auto const& [x_values, y_values, concentration_values] = grid_data;
+  auto const& concentration_data = *concentration_values;
+  auto row_size = x_values.size();
+
+  auto writer = JsonWriter{body.text()};
+  writer.beginObject();
+  writer.key("shape");
+  writer.beginArray();
+  writer.value(y_values.size());
+  writer.value(x_values.size());
+  writer.endArray();
+  writer.key("x");
+  writer.beginArray();
+  for (auto x : x_values) {
+    writer.value(x);
+  }
+  writer.endArray();
+  writer.key("y");
+  writer.beginArray();
+  for (auto y : y_values) {
+    writer.value(y);
+  }
+  writer.endArray();
+  writer.key("concentration");
+  writer.beginArray();
+  for (std::size_t i = 0; i < concentration_data.size(); ++i) {
+    writer.value(concentration_data[i]);
+    if ((i + 1) % row_size == 0) {
+      body.flush();
+    }
+  }
+  writer.endArray();
+  writer.endObject();
+}
+
+void writeGridArrow(GridData const& grid_data, DType dtype, std::string& out) {
+  auto const& [x_values, y_values, concentration_values] = grid_data;
+  auto row_size = x_values.size();
+  auto col_size = y_values.size();
+
+  // expand the coordinates to one value per cell
+  auto x_column = std::vector<double>(row_size * col_size);
+  auto y_column = std::vector<double>(row_size * col_size);
+  for (std::size_t row_idx = 0; row_idx < col_size; ++row_idx) {
+    for (std::size_t col_idx = 0; col_idx < row_size; ++col_idx) {
+      x_column[row_idx * row_size + col_idx] = x_values[col_idx];
+      y_column[row_idx * row_size + col_idx] = y_values[row_idx];
+    }
+  }
+  appendArrowStream({{"x", &x_column, DType::Float64},
+                     {"y", &y_column, DType::Float64},
+                     {"concentration", concentration_values.get(), dtype}},
+                    out);
+}
+
+void setGridHeaders(GridData const& grid_data, DType dtype,
+                    crow::response& response) {
+  setArrayHeaders({grid_data.y_values.size(), grid_data.x_values.size()},
+                  grid_data.x_values, grid_data.y_values, dtype, response);
+}
+
+void setArrayHeaders(std::vector<std::size_t> const& shape,
+                     std::vector<double> const& x_values,
+                     std::vector<double> const& y_values, DType dtype,
+                     crow::response& response) {
+  auto coordinates = [](std::vector<double> const& values) {
+    auto text = std::string{};
+    auto writer = JsonWriter{text};
+    writer.beginArray();
+    for (auto value : values) {
+      writer.value(value);
+    }
+    writer.endArray();
+    return text;
+  };
+  auto shape_text = std::string{};
+  for (auto size : shape) {
+    shape_text += (shape_text.empty() ? "" : ",") + std::to_string(size);
+  }
+  response.set_header("X-Shape", shape_text);
+  response.set_header("X-Dtype", std::string{dtypeName(dtype)});
+  response.set_header("X-Byte-Order", "little");
+  response.set_header("X-X-Values", coordinates(x_values));
+  response.set_header("X-Y-Values", coordinates(y_values));
+}
+
+SliceList getBatchSlices(Dataset const& dataset,
+                         crow::request const& request) {
+  auto body = json{};
+  try {
+    body = json::parse(request.body);
+  } catch (json::exception const&) {
+    throw BadRequest("The request body must be JSON.");
+  }
+  if (not body.is_object() or not body.contains("slices") or
+      not body["slices"].is_array()) {
+    throw BadRequest("The request body must have a 'slices' array.");
+  }
+
+  // an index or an inclusive [first, last] range, within size
+  auto range = [](json const& entry, char const* name, std::size_t size) {
+    if (not entry.contains(name)) {
+      throw BadRequest(std::string{"Each slice needs '"} + name + "'.");
+    }
+    auto const& value = entry[name];
+    auto first = std::size_t{};
+    auto last = std::size_t{};
+    if (value.is_number_unsigned()) {
+      first = last = value.get<std::size_t>();
+    } else if (value.is_array() and value.size() == 2 and
+               value[0].is_number_unsigned() and
+               value[1].is_number_unsigned()) {
+      first = value[0].get<std::size_t>();
+      last = value[1].get<std::size_t>();
+    } else {
+      throw BadRequest(std::string{"'"} + name +
+                       "' must be an index or a [first, last] range.");
+    }
+    if (first > last) {
+      throw BadRequest(std::string{"'"} + name +
+                       "' range must not be decreasing.");
+    }
+    if (last >= size) {
+      throw BadRequest(std::string{name} + " index is out of bounds.");
+    }
+    return std::pair{first, last};
+  };
+
+  auto slices = SliceList{};
+  auto max_slices = kMaxBatchValues / (dataset.ySize() * dataset.xSize());
+  for (auto const& entry : body["slices"]) {
+    if (not entry.is_object()) {
+      throw BadRequest("Each slice must be an object with 't' and 'z'.");
+    }
+    auto [t_first, t_last] = range(entry, "t", dataset.timeSize());
+    auto [z_first, z_last] = range(entry, "z", dataset.zSize());
+    if ((t_last - t_first + 1) * (z_last - z_first + 1) >
+        max_slices - slices.size()) {
+      throw BadRequest("A batch can return at most " +
+                       std::to_string(max_slices) + " slices.");
+    }
+    for (auto t_index = t_first; t_index <= t_last; ++t_index) {
+      for (auto z_index = z_first; z_index <= z_last; ++z_index) {
+        slices.emplace_back(t_index, z_index);
+      }
+    }
+  }
+  if (slices.empty()) {
+    throw BadRequest("The batch has no slices.");
+  }
+  return slices;
+}
 
-  // get grid variables from file
-  auto x = nc_file.getVar("x");
-  if (x.isNull()) {
-    throw InternalServerError("Variable 'x' not found.");
+void writeBatchJson(Dataset const& dataset, SliceList const& slices,
+                    std::vector<std::shared_ptr<double const>> const& values,
+                    ResponseBody& body) {
+  auto slice_size = dataset.ySize() * dataset.xSize();
+  auto writer = JsonWriter{body.text()};
+  writer.beginObject();
+  writer.key("shape");
+  writer.beginArray();
+  writer.value(dataset.ySize());
+  writer.value(dataset.xSize());
+  writer.endArray();
+  writer.key("x");
+  writer.beginArray();
+  for (auto x : dataset.xValues()) {
+    writer.value(x);
   }
-  auto y = nc_file.getVar("y");
-  if (y.isNull()) {
-    throw InternalServerError("Variable 'y' not found.");
+  writer.endArray();
+  writer.key("y");
+  writer.beginArray();
+  for (auto y : dataset.yValues()) {
+    writer.value(y);
   }
-  auto concentration = nc_file.getVar("concentration");
-  if (concentration.isNull()) {
-    throw InternalServerError("Variable 'concentration' not found.");
+  writer.endArray();
+  writer.key("slices");
+  writer.beginArray();
+  for (std::size_t i = 0; i < slices.size(); ++i) {
+    writer.beginObject();
+    writer.key("t_index");
+    writer.value(slices[i].first);
+    writer.key("z_index");
+    writer.value(slices[i].second);
+    writer.key("concentration");
+    writer.beginArray();
+    auto const* concentration = values[i].get();
+    for (std::size_t j = 0; j < slice_size; ++j) {
+      writer.value(concentration[j]);
+    }
+    writer.endArray();
+    writer.endObject();
+    body.flush();
   }
+  writer.endArray();
+  writer.endObject();
+}
 
-  // read variables into vectors
-  auto row_size = nc_file.getDim("x").getSize();
-  auto x_values = std::vector<double>(row_size);
-  x.getVar(x_values.data());
-  auto col_size = nc_file.getDim("y").getSize();
-  auto y_values = std::vector<double>(col_size);
-  y.getVar(y_values.data());
-  auto data_start = std::vector<std::size_t>{t_index, z_index, 0, 0};
-  auto data_count = std::vector<std::size_t>{1, 1, col_size, row_size};
-  auto concentration_data = std::vector<double>(row_size * col_size);
-  concentration.getVar(data_start, data_count, concentration_data.data());
+ContentEncoding acceptedEncoding(crow::request const& request) {
+  return negotiateEncoding(request.get_header_value("Accept-Encoding"));
+}
 
-  return {x_values, y_values, concentration_data};
+DType getDType(crow::request const& request) {
+  char const* dtype_param = request.url_params.get("dtype");
+  if (not dtype_param) {
+    return DType::Float64;
+  }
+  auto dtype = parseDType(dtype_param);
+  if (not dtype) {
+    throw BadRequest("dtype must be 'float32' or 'float64'.");
+  }
+  return *dtype;
+}
+
+OutputFormat getOutputFormat(crow::request const& request) {
+  auto output_format = OutputFormat{getDataFormat(request), "aos",
+                                    getDType(request)};
+  if (char const* layout_param = request.url_params.get("layout")) {
+    output_format.layout = layout_param;
+    if (output_format.layout != "aos" and output_format.layout != "soa") {
+      throw BadRequest("layout must be 'aos' or 'soa'.");
+    }
+    if (output_format.format != "json") {
+      throw BadRequest("layout only applies to the json format.");
+    }
+  }
+  return output_format;
+}
+
+crow::response dataResponse(GridData const& grid_data,
+                            OutputFormat const& output_format,
+                            crow::request const& request,
+                            CompressionOptions const& compression) {
+  auto const& [format, layout, dtype] = output_format;
+  auto response = crow::response{};
+  auto body = ResponseBody{acceptedEncoding(request), compression};
+  if (format == "npy") {
+    response.set_header("Content-Type", "application/x-npy");
+    setGridHeaders(grid_data, dtype, response);
+    appendNpy(*grid_data.concentration_values,
+              {grid_data.y_values.size(), grid_data.x_values.size()}, dtype,
+              body.text());
+  } else if (format == "arrow") {
+    response.set_header("Content-Type", "application/vnd.apache.arrow.stream");
+    writeGridArrow(grid_data, dtype, body.text());
+  } else if (layout == "soa") {
+    writeGridJsonSoa(grid_data, body);
+  } else {
+    writeGridJsonAos(grid_data, body);
+  }
+  body.finish(response);
+  varyOnAccept(request, response);
+  return response;
+}
+
+void varyOnAccept(crow::request const& request, crow::response& response) {
+  if (request.url_params.get("format")) {
+    return;
+  }
+  auto vary = response.get_header_value("Vary");
+  response.set_header("Vary", vary.empty() ? "Accept" : "Accept, " + vary);
+}
+
+std::string getDataFormat(crow::request const& request) {
+  if (char const* format_param = request.url_params.get("format")) {
+    auto format = std::string{format_param};
+    if (format != "json" and format != "npy" and format != "arrow") {
+      throw BadRequest("format must be 'json', 'npy' or 'arrow'.");
+    }
+    return format;
+  }
+  auto const& accept = request.get_header_value("Accept");
+  if (accept.find("application/vnd.apache.arrow.stream") !=
+      std::string::npos) {
+    return "arrow";
+  }
+  if (accept.find("application/x-npy") != std::string::npos) {
+    return "npy";
+  }
+  return "json";
 }
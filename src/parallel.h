@@ -0,0 +1,47 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Calls fn(i) for every i in [0, count) on up to thread_count threads, the
+// calling thread included. Indices are handed out in increasing order. The
+// first exception thrown by fn is rethrown once every thread has finished;
+// indices not yet started when it was thrown are skipped.
+template <typename Fn>
+void parallelFor(std::size_t count, unsigned thread_count, Fn&& fn) {
+  auto next = std::atomic<std::size_t>{0};
+  auto failed = std::atomic<bool>{false};
+  auto error = std::exception_ptr{};
+  auto error_mutex = std::mutex{};
+  auto work = [&] {
+    for (auto i = next++; i < count and not failed; i = next++) {
+      try {
+        fn(i);
+      } catch (...) {
+        auto lock = std::lock_guard{error_mutex};
+        if (not error) {
+          error = std::current_exception();
+        }
+        failed = true;
+      }
+    }
+  };
+
+  auto helpers = std::vector<std::thread>{};
+  auto helper_count = std::min<std::size_t>(thread_count, count);
+  for (std::size_t i = 1; i < helper_count; ++i) {
+    helpers.emplace_back(work);
+  }
+  work();
+  for (auto& helper : helpers) {
+    helper.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
@@ -0,0 +1,241 @@
+#include "render.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) or defined(__i386__)
+#include <immintrin.h>
+#define AERIS_HAVE_AVX2_KERNELS 1
+#endif
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+namespace {
+constexpr auto kInfinity = std::numeric_limits<double>::infinity();
+
+// Each kernel quantizes as 255 * ((value - min) / width), truncated and
+// clamped to [0, 255]. This is the expression the images were always drawn
+// with; a precomputed reciprocal would round differently and move some pixels
+// by a level.
+struct QuantizeParams {
+  double min;
+  double width;
+  double fill_value;
+};
+
+QuantizeParams quantizeParams(ValueRange range, double fill_value) {
+  auto width = range.max - range.min;
+  // an infinite width sends every finite value to 0 and a flat or empty range
+  // no longer divides by zero
+  if (not(width > 0) or not std::isfinite(width)) {
+    width = kInfinity;
+  }
+  return {std::isfinite(range.min) ? range.min : 0.0, width, fill_value};
+}
+
+bool isMissing(double value, double fill_value) {
+  return std::isnan(value) or value == fill_value;
+}
+
+void findRangeScalar(double const* values, std::size_t size,
+                     double fill_value, double& min_value, double& max_value) {
+  for (std::size_t i = 0; i < size; ++i) {
+    if (not isMissing(values[i], fill_value)) {
+      min_value = std::min(min_value, values[i]);
+      max_value = std::max(max_value, values[i]);
+    }
+  }
+}
+
+void quantizeScalar(double const* values, std::size_t size,
+                    QuantizeParams const& params, std::uint8_t* pixels) {
+  for (std::size_t i = 0; i < size; ++i) {
+    auto level = 255.0 * ((values[i] - params.min) / params.width);
+    // written so a NaN level (an infinite value over an infinite width) gives 0
+    level = level > 0.0 ? std::min(level, 255.0) : 0.0;
+    pixels[i] = isMissing(values[i], params.fill_value)
+                    ? 0
+                    : static_cast<std::uint8_t>(level);
+  }
+}
+
+#ifdef AERIS_HAVE_AVX2_KERNELS
+// All lanes whose value is neither NaN nor the fill value. Comparing against
+// a NaN fill value with NEQ_UQ is always true, so no fill value is a no-op.
+__attribute__((target("avx2"))) __m256d validMask(__m256d values,
+                                                  __m256d fill_value) {
+  return _mm256_and_pd(_mm256_cmp_pd(values, values, _CMP_ORD_Q),
+                       _mm256_cmp_pd(values, fill_value, _CMP_NEQ_UQ));
+}
+
+__attribute__((target("avx2"))) void findRangeAvx2(double const* values,
+                                                   std::size_t size,
+                                                   double fill_value,
+                                                   double& min_value,
+                                                   double& max_value) {
+  auto fill = _mm256_set1_pd(fill_value);
+  auto positive_infinity = _mm256_set1_pd(kInfinity);
+  auto negative_infinity = _mm256_set1_pd(-kInfinity);
+  auto mins = positive_infinity;
+  auto maxs = negative_infinity;
+  std::size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    auto v = _mm256_loadu_pd(values + i);
+    auto valid = validMask(v, fill);
+    mins = _mm256_min_pd(mins, _mm256_blendv_pd(positive_infinity, v, valid));
+    maxs = _mm256_max_pd(maxs, _mm256_blendv_pd(negative_infinity, v, valid));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, mins);
+  for (auto lane : lanes) {
+    min_value = std::min(min_value, lane);
+  }
+  _mm256_storeu_pd(lanes, maxs);
+  for (auto lane : lanes) {
+    max_value = std::max(max_value, lane);
+  }
+  findRangeScalar(values + i, size - i, fill_value, min_value, max_value);
+}
+
+// Quantizes four doubles to four 32-bit levels, truncating like the scalar
+// cast. Missing values are forced to 0; max_pd also maps NaN levels to 0.
+__attribute__((target("avx2"))) __m128i quantize4(
+    double const* values, __m256d min, __m256d width, __m256d fill) {
+  auto v = _mm256_loadu_pd(values);
+  auto top = _mm256_set1_pd(255.0);
+  auto level = _mm256_mul_pd(top, _mm256_div_pd(_mm256_sub_pd(v, min), width));
+  level = _mm256_min_pd(_mm256_max_pd(level, _mm256_setzero_pd()), top);
+  level = _mm256_and_pd(level, validMask(v, fill));
+  return _mm256_cvttpd_epi32(level);
+}
+
+__attribute__((target("avx2"))) void quantizeAvx2(
+    double const* values, std::size_t size, QuantizeParams const& params,
+    std::uint8_t* pixels) {
+  auto min = _mm256_set1_pd(params.min);
+  auto width = _mm256_set1_pd(params.width);
+  auto fill = _mm256_set1_pd(params.fill_value);
+  std::size_t i = 0;
+  // sixteen values at a time, narrowed to one 16-byte store
+  for (; i + 16 <= size; i += 16) {
+    auto low = _mm_packs_epi32(quantize4(values + i, min, width, fill),
+                               quantize4(values + i + 4, min, width, fill));
+    auto high = _mm_packs_epi32(quantize4(values + i + 8, min, width, fill),
+                                quantize4(values + i + 12, min, width, fill));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i),
+                     _mm_packus_epi16(low, high));
+  }
+  quantizeScalar(values + i, size - i, params, pixels + i);
+}
+
+bool haveAvx2() {
+  static auto const supported = __builtin_cpu_supports("avx2") != 0;
+  return supported;
+}
+#endif
+}  // namespace
+
+ValueRange findRange(std::vector<double> const& values, double fill_value) {
+  auto min_value = kInfinity;
+  auto max_value = -kInfinity;
+#ifdef AERIS_HAVE_AVX2_KERNELS
+  if (haveAvx2()) {
+    findRangeAvx2(values.data(), values.size(), fill_value, min_value,
+                  max_value);
+  } else {
+    findRangeScalar(values.data(), values.size(), fill_value, min_value,
+                    max_value);
+  }
+#else
+  findRangeScalar(values.data(), values.size(), fill_value, min_value,
+                  max_value);
+#endif
+  if (min_value > max_value) {
+    auto nan = std::numeric_limits<double>::quiet_NaN();
+    return {nan, nan};
+  }
+  return {min_value, max_value};
+}
+
+std::vector<std::uint8_t> quantize(std::vector<double> const& values,
+                                   ValueRange range, double fill_value) {
+  auto params = quantizeParams(range, fill_value);
+  auto pixels = std::vector<std::uint8_t>(values.size());
+#ifdef AERIS_HAVE_AVX2_KERNELS
+  if (haveAvx2()) {
+    quantizeAvx2(values.data(), values.size(), params, pixels.data());
+    return pixels;
+  }
+#endif
+  quantizeScalar(values.data(), values.size(), params, pixels.data());
+  return pixels;
+}
+
+std::vector<std::uint8_t> quantize(std::vector<double> const& values,
+                                   double fill_value) {
+  return quantize(values, findRange(values, fill_value), fill_value);
+}
+
+std::string renderPng(std::vector<double> const& values, std::size_t width,
+                      std::size_t height, double fill_value,
+                      RenderOptions const& options) {
+  auto range = ValueRange{};
+  if (options.vmin and options.vmax) {
+    range = {*options.vmin, *options.vmax};
+  } else {
+    range = findRange(values, fill_value);
+    range.min = options.vmin.value_or(range.min);
+    range.max = options.vmax.value_or(range.max);
+  }
+
+  // the range is taken before resampling, which cannot widen it
+  auto const* pixel_values = &values;
+  auto resampled = std::vector<double>{};
+  auto out_width = options.width > 0 ? options.width : width;
+  auto out_height = options.height > 0 ? options.height : height;
+  if (out_width != width or out_height != height) {
+    resampled = resample(values, width, height, out_width, out_height,
+                         options.resampling, fill_value);
+    pixel_values = &resampled;
+  }
+
+  auto levels = quantize(*pixel_values, range, fill_value);
+  auto gray = options.colormap == Colormap::Gray;
+  if (gray and not options.alpha) {
+    return encodePng(levels, out_width, out_height, 1);
+  }
+  auto has_alpha =
+      options.alpha or
+      std::any_of(pixel_values->begin(), pixel_values->end(),
+                  [&](auto v) { return isMissing(v, fill_value); });
+
+  // gray plus alpha, RGB or RGBA
+  auto color_channels = gray ? 1 : 3;
+  auto channels = color_channels + (has_alpha ? 1 : 0);
+  auto const& lut = colormapLut(options.colormap);
+  auto pixels = std::vector<std::uint8_t>(levels.size() * channels);
+  for (std::size_t i = 0; i < levels.size(); ++i) {
+    auto* pixel = pixels.data() + i * channels;
+    std::copy_n(lut[levels[i]].begin(), color_channels, pixel);
+    if (has_alpha) {
+      pixel[color_channels] =
+          isMissing((*pixel_values)[i], fill_value) ? 0 : 255;
+    }
+  }
+  return encodePng(pixels, out_width, out_height, channels);
+}
+
+std::string encodePng(std::vector<std::uint8_t> const& pixels,
+                      std::size_t width, std::size_t height, int channels) {
+  auto png = std::string{};
+  stbi_write_png_to_func(
+      [](void* context, void* data, int size) {
+        static_cast<std::string*>(context)->append(static_cast<char*>(data),
+                                                   size);
+      },
+      &png, static_cast<int>(width), static_cast<int>(height), channels,
+      pixels.data(), static_cast<int>(width) * channels);
+  return png;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "colormap.h"
+#include "resample.h"
+#include "statistics.h"
+
+// An encoded image together with its strong entity tag.
+struct RenderedImage {
+  std::string png;
+  std::string etag;
+};
+
+// Smallest and largest values that are neither NaN nor fill_value (pass NaN
+// when there is no fill value). Both are NaN if no value qualifies.
+ValueRange findRange(std::vector<double> const& values, double fill_value);
+
+// Maps range linearly onto 0-255, truncating, and clamps values outside it.
+// NaN and fill_value map to 0, as does everything when the range is empty or
+// flat.
+std::vector<std::uint8_t> quantize(std::vector<double> const& values,
+                                   ValueRange range, double fill_value);
+
+// Same, over the range of the values themselves.
+std::vector<std::uint8_t> quantize(std::vector<double> const& values,
+                                   double fill_value);
+
+// How values become pixels. A bound left unset comes from the range of the
+// values being rendered. An output size of zero keeps the size of the data.
+struct RenderOptions {
+  Colormap colormap = Colormap::Gray;
+  std::optional<double> vmin;
+  std::optional<double> vmax;
+  std::size_t width = 0;
+  std::size_t height = 0;
+  Resampling resampling = Resampling::Nearest;
+  // always add an alpha channel with missing values transparent, even for
+  // gray and even if no value is missing, so that every image rendered with
+  // these options has the same color type
+  bool alpha = false;
+};
+
+// Renders row-major values of the given shape as a PNG, resampled to the
+// output size of the options. Unless options.alpha is set, gray gives a
+// single-channel image with missing values (NaN or fill_value) drawn black.
+// Other colormaps give an RGB image, or RGBA with missing values transparent
+// if there are any.
+std::string renderPng(std::vector<double> const& values, std::size_t width,
+                      std::size_t height, double fill_value,
+                      RenderOptions const& options);
+
+// Encodes row-major pixels with the given number of channels as a PNG.
+std::string encodePng(std::vector<std::uint8_t> const& pixels,
+                      std::size_t width, std::size_t height, int channels);
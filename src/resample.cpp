@@ -0,0 +1,154 @@
+#include "resample.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+// Source index of each output index under nearest-neighbour sampling.
+std::vector<std::size_t> nearestIndices(std::size_t src_size,
+                                        std::size_t size) {
+  auto indices = std::vector<std::size_t>(size);
+  auto ratio = static_cast<double>(src_size) / size;
+  for (std::size_t i = 0; i < size; ++i) {
+    indices[i] =
+        std::min(static_cast<std::size_t>((i + 0.5) * ratio), src_size - 1);
+  }
+  return indices;
+}
+
+// The two source indices each output index lies between and the weight of
+// the second one.
+struct LinearTaps {
+  std::vector<std::size_t> first;
+  std::vector<std::size_t> second;
+  std::vector<double> weight;
+};
+
+LinearTaps linearTaps(std::size_t src_size, std::size_t size) {
+  auto taps = LinearTaps{std::vector<std::size_t>(size),
+                         std::vector<std::size_t>(size),
+                         std::vector<double>(size)};
+  auto ratio = static_cast<double>(src_size) / size;
+  auto last = static_cast<double>(src_size - 1);
+  for (std::size_t i = 0; i < size; ++i) {
+    auto position = std::clamp((i + 0.5) * ratio - 0.5, 0.0, last);
+    taps.first[i] = static_cast<std::size_t>(position);
+    taps.second[i] = std::min(taps.first[i] + 1, src_size - 1);
+    taps.weight[i] = position - taps.first[i];
+  }
+  return taps;
+}
+
+std::vector<double> resampleNearest(std::vector<double> const& values,
+                                    std::size_t src_width,
+                                    std::size_t src_height, std::size_t width,
+                                    std::size_t height) {
+  auto columns = nearestIndices(src_width, width);
+  auto rows = nearestIndices(src_height, height);
+  auto out = std::vector<double>(width * height);
+  for (std::size_t y = 0; y < height; ++y) {
+    auto* out_row = out.data() + y * width;
+    // consecutive output rows often sample the same source row
+    if (y > 0 and rows[y] == rows[y - 1]) {
+      std::copy(out_row - width, out_row, out_row);
+      continue;
+    }
+    auto const* src_row = values.data() + rows[y] * src_width;
+    for (std::size_t x = 0; x < width; ++x) {
+      out_row[x] = src_row[columns[x]];
+    }
+  }
+  return out;
+}
+
+// Separable: every source row is first resampled horizontally, then each
+// output row blends two of those rows with one weight. That blend is a
+// contiguous loop, which GCC vectorizes at -O3 (the default Release build)
+// but not at -O2.
+std::vector<double> resampleBilinear(std::vector<double> const& values,
+                                     std::size_t src_width,
+                                     std::size_t src_height, std::size_t width,
+                                     std::size_t height, double fill_value) {
+  constexpr auto kNaN = std::numeric_limits<double>::quiet_NaN();
+  auto columns = linearTaps(src_width, width);
+  auto rows = linearTaps(src_height, height);
+
+  auto horizontal = std::vector<double>(src_height * width);
+  for (std::size_t y = 0; y < src_height; ++y) {
+    auto const* src_row = values.data() + y * src_width;
+    auto* row = horizontal.data() + y * width;
+    for (std::size_t x = 0; x < width; ++x) {
+      auto left = src_row[columns.first[x]];
+      auto right = src_row[columns.second[x]];
+      left = left == fill_value ? kNaN : left;
+      right = right == fill_value ? kNaN : right;
+      // a zero weight must not let a missing neighbour through
+      row[x] = columns.weight[x] == 0.0
+                   ? left
+                   : left + columns.weight[x] * (right - left);
+    }
+  }
+
+  auto out = std::vector<double>(width * height);
+  for (std::size_t y = 0; y < height; ++y) {
+    auto const* top = horizontal.data() + rows.first[y] * width;
+    auto const* bottom = horizontal.data() + rows.second[y] * width;
+    auto weight = rows.weight[y];
+    auto* out_row = out.data() + y * width;
+    if (weight == 0.0) {
+      std::copy(top, top + width, out_row);
+      continue;
+    }
+    for (std::size_t x = 0; x < width; ++x) {
+      out_row[x] = top[x] + weight * (bottom[x] - top[x]);
+    }
+  }
+  return out;
+}
+}  // namespace
+
+std::optional<Resampling> parseResampling(std::string_view name) {
+  if (name == "nearest") {
+    return Resampling::Nearest;
+  }
+  if (name == "bilinear") {
+    return Resampling::Bilinear;
+  }
+  return std::nullopt;
+}
+
+std::string_view resamplingName(Resampling resampling) {
+  return resampling == Resampling::Bilinear ? "bilinear" : "nearest";
+}
+
+double interpolateBilinear(double const* values, std::size_t row_size,
+                           AxisPosition x, AxisPosition y, double fill_value) {
+  constexpr auto kNaN = std::numeric_limits<double>::quiet_NaN();
+  auto at = [&](std::size_t row, std::size_t column) {
+    auto value = values[row * row_size + column];
+    return value == fill_value ? kNaN : value;
+  };
+  auto along_row = [&](std::size_t row) {
+    auto left = at(row, x.index);
+    return x.weight == 0.0 ? left
+                           : left + x.weight * (at(row, x.index + 1) - left);
+  };
+  auto top = along_row(y.index);
+  return y.weight == 0.0 ? top
+                         : top + y.weight * (along_row(y.index + 1) - top);
+}
+
+std::vector<double> resample(std::vector<double> const& values,
+                             std::size_t src_width, std::size_t src_height,
+                             std::size_t width, std::size_t height,
+                             Resampling resampling, double fill_value) {
+  if (values.empty() or width == 0 or height == 0) {
+    return std::vector<double>(width * height);
+  }
+  if (resampling == Resampling::Bilinear) {
+    return resampleBilinear(values, src_width, src_height, width, height,
+                            fill_value);
+  }
+  return resampleNearest(values, src_width, src_height, width, height);
+}
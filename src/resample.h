@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "coordinates.h"
+
+enum class Resampling { Nearest, Bilinear };
+
+// Parses "nearest" or "bilinear"; returns std::nullopt for anything else.
+std::optional<Resampling> parseResampling(std::string_view name);
+std::string_view resamplingName(Resampling resampling);
+
+// Resamples a row-major (src_height, src_width) grid to (height, width) with
+// pixel centers aligned. Bilinear treats fill_value like NaN, so an output
+// value that draws on a missing value is missing as well.
+std::vector<double> resample(std::vector<double> const& values,
+                             std::size_t src_width, std::size_t src_height,
+                             std::size_t width, std::size_t height,
+                             Resampling resampling, double fill_value);
+
+// Bilinearly interpolates a row-major grid with row_size columns between the
+// points at the given positions and the ones after them, treating fill_value
+// like NaN as resample does. Points with a zero weight are not read.
+double interpolateBilinear(double const* values, std::size_t row_size,
+                           AxisPosition x, AxisPosition y, double fill_value);
@@ -0,0 +1,112 @@
+#include "series_index.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace {
+// Values read per block while building a level.
+constexpr std::size_t kBlockValues = std::size_t{1} << 21;
+
+// Writes a rows x cols row-major matrix transposed into out, whose rows are
+// out_stride long, starting at column out_offset. Works in tiles to stay
+// cache friendly.
+void transposeInto(std::vector<double> const& matrix, std::size_t rows,
+                   std::size_t cols, std::vector<double>& out,
+                   std::size_t out_stride, std::size_t out_offset) {
+  constexpr std::size_t kTile = 32;
+  for (std::size_t row_tile = 0; row_tile < rows; row_tile += kTile) {
+    auto row_end = std::min(row_tile + kTile, rows);
+    for (std::size_t col_tile = 0; col_tile < cols; col_tile += kTile) {
+      auto col_end = std::min(col_tile + kTile, cols);
+      for (auto row = row_tile; row < row_end; ++row) {
+        for (auto col = col_tile; col < col_end; ++col) {
+          out[col * out_stride + out_offset + row] = matrix[row * cols + col];
+        }
+      }
+    }
+  }
+}
+}  // namespace
+
+SeriesIndex::SeriesIndex(Dataset const& dataset, Mode mode,
+                         std::size_t budget_bytes)
+    : dataset_{dataset},
+      mode_{mode},
+      budget_bytes_{budget_bytes},
+      levels_(dataset.zSize()) {
+  if (mode_ == Mode::Startup) {
+    for (std::size_t z_index = 0; z_index < dataset_.zSize(); ++z_index) {
+      level(z_index);
+    }
+  }
+}
+
+std::vector<double> SeriesIndex::series(std::size_t x_index,
+                                        std::size_t y_index,
+                                        std::size_t z_index) const {
+  auto indexed = level(z_index);
+  if (not indexed) {
+    return dataset_.readSeries(x_index, y_index, z_index);
+  }
+  auto t_size = dataset_.timeSize();
+  auto const* first =
+      indexed->data() + (y_index * dataset_.xSize() + x_index) * t_size;
+  return std::vector<double>(first, first + t_size);
+}
+
+std::shared_ptr<std::vector<double> const> SeriesIndex::level(
+    std::size_t z_index) const {
+  using LevelPtr = std::shared_ptr<std::vector<double> const>;
+  auto level_bytes = dataset_.timeSize() * dataset_.ySize() *
+                     dataset_.xSize() * sizeof(double);
+  auto promise = std::promise<LevelPtr>{};
+  auto built = std::shared_future<LevelPtr>{};
+  {
+    auto lock = std::lock_guard{mutex_};
+    if (mode_ == Mode::Off) {
+      return nullptr;
+    }
+    if (levels_[z_index].valid()) {
+      built = levels_[z_index];
+    } else if (used_bytes_ + level_bytes > budget_bytes_) {
+      return nullptr;
+    } else {
+      // claim the level; the memory is reserved before it is allocated
+      used_bytes_ += level_bytes;
+      levels_[z_index] = promise.get_future().share();
+    }
+  }
+  // somebody else builds, or has built, this level
+  if (built.valid()) {
+    return built.get();
+  }
+
+  try {
+    auto level = std::make_shared<std::vector<double> const>(build(z_index));
+    promise.set_value(level);
+    return level;
+  } catch (...) {
+    // let a later request try again rather than keeping the error
+    {
+      auto lock = std::lock_guard{mutex_};
+      levels_[z_index] = {};
+      used_bytes_ -= level_bytes;
+    }
+    promise.set_exception(std::current_exception());
+    throw;
+  }
+}
+
+std::vector<double> SeriesIndex::build(std::size_t z_index) const {
+  // (time, y, x) as stored becomes (y, x, time)
+  auto t_size = dataset_.timeSize();
+  auto cell_count = dataset_.ySize() * dataset_.xSize();
+  auto level = std::vector<double>(t_size * cell_count);
+  auto block_steps = std::max<std::size_t>(1, kBlockValues / cell_count);
+  for (std::size_t t_start = 0; t_start < t_size; t_start += block_steps) {
+    auto t_count = std::min(block_steps, t_size - t_start);
+    transposeInto(dataset_.readLevel(z_index, t_start, t_count), t_count,
+                  cell_count, level, t_size, t_start);
+  }
+  return level;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "dataset.h"
+
+// Time-major copy of the concentration variable, so that the whole time series
+// at one grid point is a single contiguous read instead of one value from each
+// stored (y, x) slice. The copy is built one z level at a time, either at
+// startup or the first time a series at that level is requested, for as many
+// levels as fit in the memory budget. Series at other levels are read from the
+// file directly. A level is built outside the index lock, so only requests for
+// that level wait for it.
+class SeriesIndex {
+ public:
+  enum class Mode { Off, Lazy, Startup };
+
+  SeriesIndex(Dataset const& dataset, Mode mode, std::size_t budget_bytes);
+
+  // Returns the values at one grid point for every time step. Indices are not
+  // bounds checked. Safe to call from multiple threads.
+  std::vector<double> series(std::size_t x_index, std::size_t y_index,
+                             std::size_t z_index) const;
+
+ private:
+  // Returns the (y, x, time) copy of a level, building it if allowed, or
+  // nullptr if the level is not indexed.
+  std::shared_ptr<std::vector<double> const> level(std::size_t z_index) const;
+
+  // Reads a level a block of time steps at a time, transposing each block
+  // into place, so that no more than one block is held besides the copy.
+  std::vector<double> build(std::size_t z_index) const;
+
+  Dataset const& dataset_;
+  Mode mode_;
+  std::size_t budget_bytes_;
+  mutable std::mutex mutex_;
+  // invalid until a level is claimed for building
+  mutable std::vector<
+      std::shared_future<std::shared_ptr<std::vector<double> const>>>
+      levels_;
+  mutable std::size_t used_bytes_ = 0;
+};
@@ -0,0 +1,174 @@
+#include "statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <iostream>
+#include <limits>
+
+#include "parallel.h"
+
+SliceStats computeStats(std::vector<double> const& values, double fill_value,
+                        std::size_t bin_count) {
+  constexpr auto kNaN = std::numeric_limits<double>::quiet_NaN();
+  auto is_missing = [fill_value](double value) {
+    return std::isnan(value) or value == fill_value;
+  };
+
+  // min, max and Welford's running mean and sum of squared deviations
+  auto min_value = std::numeric_limits<double>::infinity();
+  auto max_value = -std::numeric_limits<double>::infinity();
+  auto mean = 0.0;
+  auto m2 = 0.0;
+  std::size_t count = 0;
+  std::size_t missing_count = 0;
+  for (auto value : values) {
+    if (is_missing(value)) {
+      ++missing_count;
+      continue;
+    }
+    min_value = std::min(min_value, value);
+    max_value = std::max(max_value, value);
+    ++count;
+    auto delta = value - mean;
+    mean += delta / count;
+    m2 += delta * (value - mean);
+  }
+
+  auto stats = SliceStats{};
+  stats.count = count;
+  stats.missing_count = missing_count;
+  stats.histogram.assign(bin_count, 0);
+  if (count == 0) {
+    stats.min = stats.max = stats.mean = stats.stddev = kNaN;
+    return stats;
+  }
+  stats.min = min_value;
+  stats.max = max_value;
+  stats.mean = mean;
+  stats.stddev = std::sqrt(m2 / count);
+
+  // a flat field puts everything in the first bin
+  auto range = max_value - min_value;
+  auto scale = range > 0 ? bin_count / range : 0.0;
+  for (auto value : values) {
+    if (is_missing(value) or bin_count == 0) {
+      continue;
+    }
+    auto bin = static_cast<std::size_t>((value - min_value) * scale);
+    ++stats.histogram[std::min(bin, bin_count - 1)];
+  }
+  return stats;
+}
+
+StatsIndex::StatsIndex(Dataset const& dataset, Mode mode)
+    : dataset_{dataset},
+      entries_(dataset.timeSize() * dataset.zSize()),
+      level_ranges_(dataset.zSize()) {
+  if (mode == Mode::Background) {
+    for (unsigned i = 0; i < kScanThreads; ++i) {
+      scanners_.emplace_back([this] { scan(); });
+    }
+  }
+}
+
+StatsIndex::~StatsIndex() {
+  stop_ = true;
+  for (auto& scanner : scanners_) {
+    scanner.join();
+  }
+}
+
+std::shared_ptr<SliceStats const> StatsIndex::stats(
+    std::size_t t_index, std::size_t z_index) const {
+  if (auto stats = find(t_index * dataset_.zSize() + z_index)) {
+    return stats;
+  }
+  // a client is waiting for this slice, so it may as well be cached
+  return compute(t_index, z_index, true);
+}
+
+ValueRange StatsIndex::levelRange(std::size_t z_index) const {
+  {
+    auto lock = std::lock_guard{mutex_};
+    if (level_ranges_[z_index]) {
+      return *level_ranges_[z_index];
+    }
+  }
+  // slices without statistics yet are filled in like the background scan
+  // does, one thread computing while another reads
+  auto level = std::vector<std::shared_ptr<SliceStats const>>(
+      dataset_.timeSize());
+  parallelFor(level.size(), kScanThreads, [&](std::size_t t_index) {
+    level[t_index] = find(t_index * dataset_.zSize() + z_index);
+    if (not level[t_index]) {
+      level[t_index] = compute(t_index, z_index, false);
+    }
+  });
+  // fmin and fmax skip the NaN extrema of slices with no values
+  auto range = ValueRange{std::numeric_limits<double>::quiet_NaN(),
+                          std::numeric_limits<double>::quiet_NaN()};
+  for (auto const& stats : level) {
+    range.min = std::fmin(range.min, stats->min);
+    range.max = std::fmax(range.max, stats->max);
+  }
+  auto lock = std::lock_guard{mutex_};
+  level_ranges_[z_index] = range;
+  return range;
+}
+
+ValueRange StatsIndex::variableRange() const {
+  auto range = ValueRange{std::numeric_limits<double>::quiet_NaN(),
+                          std::numeric_limits<double>::quiet_NaN()};
+  for (std::size_t z_index = 0; z_index < dataset_.zSize(); ++z_index) {
+    auto level = levelRange(z_index);
+    range.min = std::fmin(range.min, level.min);
+    range.max = std::fmax(range.max, level.max);
+  }
+  return range;
+}
+
+std::shared_ptr<SliceStats const> StatsIndex::find(std::size_t entry) const {
+  auto lock = std::lock_guard{mutex_};
+  return entries_[entry];
+}
+
+std::shared_ptr<SliceStats const> StatsIndex::compute(std::size_t t_index,
+                                                      std::size_t z_index,
+                                                      bool cache_slice) const {
+  auto values = cache_slice
+                    ? dataset_.readSlice(t_index, z_index)
+                    : std::make_shared<std::vector<double> const>(
+                          dataset_.readSliceUncached(t_index, z_index));
+  auto stats = std::make_shared<SliceStats const>(
+      computeStats(*values, dataset_.fillValue(), kBinCount));
+  auto lock = std::lock_guard{mutex_};
+  auto& entry = entries_[t_index * dataset_.zSize() + z_index];
+  if (not entry) {
+    entry = stats;
+  }
+  return entry;
+}
+
+void StatsIndex::scan() {
+  // threads take slices in turn, so the scan still runs roughly in file order
+  while (not stop_) {
+    auto entry = next_entry_++;
+    if (entry >= entries_.size()) {
+      return;
+    }
+    if (find(entry)) {
+      continue;
+    }
+    auto t_index = entry / dataset_.zSize();
+    auto z_index = entry % dataset_.zSize();
+    // an unreadable slice must not take the server down; the entry stays
+    // empty, so a request for it retries the read and reports the error
+    try {
+      compute(t_index, z_index, false);
+    } catch (std::exception const& e) {
+      std::cerr << "Statistics scan skipped slice t=" << t_index
+                << ", z=" << z_index << ": " << e.what() << '\n';
+    }
+  }
+}
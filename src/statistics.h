@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "dataset.h"
+
+// Closed interval of data values.
+struct ValueRange {
+  double min;
+  double max;
+};
+
+// Summary of the values in one slice. Missing values (NaN or the fill value)
+// are counted separately and otherwise ignored; min, max, mean and stddev are
+// NaN if every value is missing.
+struct SliceStats {
+  double min;
+  double max;
+  double mean;
+  double stddev;  // population standard deviation
+  std::size_t count;
+  std::size_t missing_count;
+  // counts in equal-width bins spanning [min, max]
+  std::vector<std::size_t> histogram;
+};
+
+// Computes the min, max, mean, standard deviation and missing count in a
+// single fused pass, then fills the histogram in a second pass once the range
+// is known. Pass NaN as fill_value when there is none.
+SliceStats computeStats(std::vector<double> const& values, double fill_value,
+                        std::size_t bin_count);
+
+// Per-slice statistics for every (t, z) slice, each computed at most once.
+// Entries are filled either lazily as they are requested or by background
+// threads that scan the whole variable after startup; requests for slices the
+// scan has not reached yet are computed on demand.
+//
+// The extrema of a z level over all time steps, and of the whole variable,
+// are reduced from the slice entries the first time they are asked for and
+// kept from then on.
+class StatsIndex {
+ public:
+  enum class Mode { Lazy, Background };
+
+  static constexpr std::size_t kBinCount = 32;
+
+  // With Mode::Background, kScanThreads threads scan the file, so one can
+  // compute statistics while the other reads. File access is serialized, so
+  // more scanners would only compete with requests for the file lock.
+  static constexpr unsigned kScanThreads = 2;
+
+  StatsIndex(Dataset const& dataset, Mode mode);
+  ~StatsIndex();
+  StatsIndex(StatsIndex const&) = delete;
+  StatsIndex& operator=(StatsIndex const&) = delete;
+
+  // Indices are not bounds checked. Safe to call from multiple threads.
+  std::shared_ptr<SliceStats const> stats(std::size_t t_index,
+                                          std::size_t z_index) const;
+
+  // Both are NaN if every value is missing. The first call for a z level may
+  // have to read every slice of it that has no statistics yet, which it does
+  // on kScanThreads threads.
+  ValueRange levelRange(std::size_t z_index) const;
+  ValueRange variableRange() const;
+
+ private:
+  std::shared_ptr<SliceStats const> find(std::size_t entry) const;
+  std::shared_ptr<SliceStats const> compute(std::size_t t_index,
+                                            std::size_t z_index,
+                                            bool cache_slice) const;
+  void scan();
+
+  Dataset const& dataset_;
+  mutable std::mutex mutex_;
+  // indexed by t_index * z size + z_index
+  mutable std::vector<std::shared_ptr<SliceStats const>> entries_;
+  mutable std::vector<std::optional<ValueRange>> level_ranges_;
+  std::atomic<std::size_t> next_entry_{0};
+  std::atomic<bool> stop_{false};
+  std::vector<std::thread> scanners_;
+};
@@ -0,0 +1,103 @@
+#include "tiles.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+constexpr auto kNaN = std::numeric_limits<double>::quiet_NaN();
+}  // namespace
+
+TilePyramid::TilePyramid(std::vector<double> const& values, std::size_t width,
+                         std::size_t height, double fill_value) {
+  // the native level is the first whose pixel size covers the slice
+  std::size_t native_level = 0;
+  while ((kTileSize << native_level) < std::max(width, height)) {
+    ++native_level;
+  }
+  levels_.resize(native_level + 1);
+
+  auto& native = levels_.back();
+  native = {width, height, values};
+  for (auto& value : native.values) {
+    value = value == fill_value ? kNaN : value;
+  }
+
+  for (auto level = native_level; level-- > 0;) {
+    auto const& fine = levels_[level + 1];
+    auto& coarse = levels_[level];
+    coarse.width = (fine.width + 1) / 2;
+    coarse.height = (fine.height + 1) / 2;
+    coarse.values.resize(coarse.width * coarse.height);
+    for (std::size_t y = 0; y < coarse.height; ++y) {
+      for (std::size_t x = 0; x < coarse.width; ++x) {
+        auto sum = 0.0;
+        auto count = 0;
+        for (auto fy = 2 * y; fy < std::min(2 * y + 2, fine.height); ++fy) {
+          for (auto fx = 2 * x; fx < std::min(2 * x + 2, fine.width); ++fx) {
+            auto value = fine.values[fy * fine.width + fx];
+            if (not std::isnan(value)) {
+              sum += value;
+              ++count;
+            }
+          }
+        }
+        coarse.values[y * coarse.width + x] = count > 0 ? sum / count : kNaN;
+      }
+    }
+  }
+}
+
+std::size_t TilePyramid::pixelWidth(std::size_t level) const {
+  if (level <= nativeLevel()) {
+    return levels_[level].width;
+  }
+  return levels_.back().width << (level - nativeLevel());
+}
+
+std::size_t TilePyramid::pixelHeight(std::size_t level) const {
+  if (level <= nativeLevel()) {
+    return levels_[level].height;
+  }
+  return levels_.back().height << (level - nativeLevel());
+}
+
+bool TilePyramid::contains(std::size_t level, std::size_t tx,
+                           std::size_t ty) const {
+  if (level > nativeLevel() + kMaxOverzoom) {
+    return false;
+  }
+  auto tiles_x = (pixelWidth(level) + kTileSize - 1) / kTileSize;
+  auto tiles_y = (pixelHeight(level) + kTileSize - 1) / kTileSize;
+  return tx < tiles_x and ty < tiles_y;
+}
+
+std::vector<double> TilePyramid::tile(std::size_t level, std::size_t tx,
+                                      std::size_t ty) const {
+  auto const& source = levels_[std::min(level, nativeLevel())];
+  // enlarged levels repeat each grid cell over shift-by-shift pixels
+  auto shift = level > nativeLevel() ? level - nativeLevel() : 0;
+  auto x0 = tx * kTileSize;
+  auto y0 = ty * kTileSize;
+  auto width = std::min(kTileSize, pixelWidth(level) - x0);
+  auto height = std::min(kTileSize, pixelHeight(level) - y0);
+
+  auto values = std::vector<double>(kTileSize * kTileSize, kNaN);
+  for (std::size_t y = 0; y < height; ++y) {
+    auto const* src_row = source.values.data() +
+                          ((y0 + y) >> shift) * source.width;
+    auto* row = values.data() + y * kTileSize;
+    for (std::size_t x = 0; x < width; ++x) {
+      row[x] = src_row[(x0 + x) >> shift];
+    }
+  }
+  return values;
+}
+
+std::size_t TilePyramid::bytes() const {
+  std::size_t total = 0;
+  for (auto const& level : levels_) {
+    total += level.values.size() * sizeof(double);
+  }
+  return total;
+}
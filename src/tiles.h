@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Edge length of a map tile in pixels.
+constexpr std::size_t kTileSize = 256;
+
+// How many levels past one pixel per grid cell a pyramid serves, by
+// enlarging its full resolution level.
+constexpr std::size_t kMaxOverzoom = 8;
+
+// Downsampled copies of one slice for serving XYZ map tiles. Level 0 fits the
+// whole slice in one tile and each following level doubles the resolution, up
+// to the native level at which one pixel is one grid cell. Every level below
+// that averages 2x2 blocks of the one above, skipping missing values.
+//
+// Missing values are stored as NaN, whatever the fill value of the data.
+class TilePyramid {
+ public:
+  // Takes row-major (height, width) slice values.
+  TilePyramid(std::vector<double> const& values, std::size_t width,
+              std::size_t height, double fill_value);
+
+  std::size_t nativeLevel() const { return levels_.size() - 1; }
+
+  // Whether the tile overlaps the slice at a level that is served.
+  bool contains(std::size_t level, std::size_t tx, std::size_t ty) const;
+
+  // Values of one tile, kTileSize by kTileSize in row-major order, with NaN
+  // where the tile extends past the slice. The tile must be contained.
+  std::vector<double> tile(std::size_t level, std::size_t tx,
+                           std::size_t ty) const;
+
+  std::size_t bytes() const;
+
+ private:
+  struct Level {
+    std::size_t width;
+    std::size_t height;
+    std::vector<double> values;
+  };
+
+  // Size of the slice in pixels at any level, including enlarged ones.
+  std::size_t pixelWidth(std::size_t level) const;
+  std::size_t pixelHeight(std::size_t level) const;
+
+  std::vector<Level> levels_;  // indexed by level
+};
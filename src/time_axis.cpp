@@ -0,0 +1,270 @@
+#include "time_axis.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+namespace {
+constexpr double kSecondsPerDay = 86400.0;
+
+// Reads an unsigned number of 1 to max_digits digits from the front of text.
+std::optional<int> readNumber(std::string_view& text, std::size_t max_digits) {
+  auto digits = std::size_t{};
+  auto number = 0;
+  while (digits < text.size() and digits < max_digits and
+         std::isdigit(static_cast<unsigned char>(text[digits]))) {
+    number = number * 10 + (text[digits] - '0');
+    ++digits;
+  }
+  if (digits == 0) {
+    return std::nullopt;
+  }
+  text.remove_prefix(digits);
+  return number;
+}
+
+bool consume(std::string_view& text, char c) {
+  if (text.empty() or text.front() != c) {
+    return false;
+  }
+  text.remove_prefix(1);
+  return true;
+}
+
+std::string_view trim(std::string_view text) {
+  while (not text.empty() and
+         std::isspace(static_cast<unsigned char>(text.front()))) {
+    text.remove_prefix(1);
+  }
+  while (not text.empty() and
+         std::isspace(static_cast<unsigned char>(text.back()))) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+bool isGregorianLeapYear(int year) {
+  return year % 4 == 0 and (year % 100 != 0 or year % 400 == 0);
+}
+
+int daysInMonth(int year, int month, Calendar calendar) {
+  constexpr int kDays[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  switch (calendar) {
+    case Calendar::Day360:
+      return 30;
+    case Calendar::NoLeap:
+      return kDays[month - 1];
+    case Calendar::AllLeap:
+      return month == 2 ? 29 : kDays[month - 1];
+    default:
+      return month == 2 and isGregorianLeapYear(year) ? 29 : kDays[month - 1];
+  }
+}
+
+// Days from 0000-01-01 in the calendar. The Gregorian count follows Howard
+// Hinnant's days_from_civil.
+double dayNumber(DateTime const& date, Calendar calendar) {
+  constexpr int kDaysBefore[12] = {0,   31,  59,  90,  120, 151,
+                                   181, 212, 243, 273, 304, 334};
+  auto year = static_cast<double>(date.year);
+  auto month_index = date.month - 1;
+  auto day_index = date.day - 1;
+  switch (calendar) {
+    case Calendar::Day360:
+      return year * 360 + month_index * 30 + day_index;
+    case Calendar::NoLeap:
+      return year * 365 + kDaysBefore[month_index] + day_index;
+    case Calendar::AllLeap:
+      return year * 366 + kDaysBefore[month_index] + (date.month > 2) +
+             day_index;
+    default: {
+      // years starting in March put the leap day last
+      auto y = date.year - (date.month <= 2);
+      auto era = (y >= 0 ? y : y - 399) / 400;
+      auto year_of_era = y - era * 400;
+      auto shifted_month = date.month > 2 ? date.month - 3 : date.month + 9;
+      auto day_of_year = (153 * shifted_month + 2) / 5 + day_index;
+      auto day_of_era = year_of_era * 365 + year_of_era / 4 -
+                        year_of_era / 100 + day_of_year;
+      return era * 146097.0 + day_of_era + 60;  // 0000-03-01 is day 60
+    }
+  }
+}
+
+// Length of a CF time unit in seconds, or zero if it is not one.
+double unitSeconds(std::string_view unit) {
+  constexpr std::pair<std::string_view, double> kUnits[] = {
+      {"seconds", 1.0},    {"second", 1.0},     {"secs", 1.0},
+      {"sec", 1.0},        {"s", 1.0},          {"minutes", 60.0},
+      {"minute", 60.0},    {"mins", 60.0},      {"min", 60.0},
+      {"hours", 3600.0},   {"hour", 3600.0},    {"hrs", 3600.0},
+      {"hr", 3600.0},      {"h", 3600.0},       {"days", 86400.0},
+      {"day", 86400.0},    {"d", 86400.0},      {"weeks", 604800.0},
+      {"week", 604800.0}};
+  for (auto [name, seconds] : kUnits) {
+    if (unit == name) {
+      return seconds;
+    }
+  }
+  return 0.0;
+}
+}  // namespace
+
+std::optional<Calendar> parseCalendar(std::string_view name) {
+  auto lower = std::string{trim(name)};
+  for (auto& c : lower) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  if (lower.empty() or lower == "standard" or lower == "gregorian" or
+      lower == "proleptic_gregorian") {
+    return Calendar::Standard;
+  }
+  if (lower == "noleap" or lower == "365_day") {
+    return Calendar::NoLeap;
+  }
+  if (lower == "all_leap" or lower == "366_day") {
+    return Calendar::AllLeap;
+  }
+  if (lower == "360_day") {
+    return Calendar::Day360;
+  }
+  return std::nullopt;
+}
+
+std::optional<DateTime> parseDateTime(std::string_view text) {
+  text = trim(text);
+  auto year = readNumber(text, 4);
+  if (not year or not consume(text, '-')) {
+    return std::nullopt;
+  }
+  auto month = readNumber(text, 2);
+  if (not month or not consume(text, '-')) {
+    return std::nullopt;
+  }
+  auto day = readNumber(text, 2);
+  if (not day or *month < 1 or *month > 12 or *day < 1) {
+    return std::nullopt;
+  }
+  auto date = DateTime{*year, *month, *day};
+  if (text.empty()) {
+    return date;
+  }
+
+  // time of day
+  if (not consume(text, 'T') and not consume(text, ' ')) {
+    return std::nullopt;
+  }
+  text = trim(text);
+  auto hour = readNumber(text, 2);
+  if (not hour or not consume(text, ':')) {
+    return std::nullopt;
+  }
+  auto minute = readNumber(text, 2);
+  if (not minute or *hour > 23 or *minute > 59) {
+    return std::nullopt;
+  }
+  auto second = 0.0;
+  if (consume(text, ':')) {
+    auto digits = std::string{};
+    while (not text.empty() and
+           (std::isdigit(static_cast<unsigned char>(text.front())) or
+            text.front() == '.')) {
+      digits += text.front();
+      text.remove_prefix(1);
+    }
+    char* end = nullptr;
+    second = std::strtod(digits.c_str(), &end);
+    if (digits.empty() or *end != '\0' or second >= 61.0) {
+      return std::nullopt;
+    }
+  }
+  date.seconds = *hour * 3600.0 + *minute * 60.0 + second;
+
+  // time zone, as an offset from UTC
+  text = trim(text);
+  if (text.empty() or text == "Z" or text == "UTC") {
+    return date;
+  }
+  auto sign = text.front() == '-' ? -1 : 1;
+  if (not consume(text, '+') and not consume(text, '-')) {
+    return std::nullopt;
+  }
+  auto offset_hours = readNumber(text, 2);
+  auto offset_minutes = std::optional<int>{0};
+  if (consume(text, ':')) {
+    offset_minutes = readNumber(text, 2);
+  }
+  if (not offset_hours or not offset_minutes or not text.empty()) {
+    return std::nullopt;
+  }
+  date.seconds -= sign * (*offset_hours * 3600.0 + *offset_minutes * 60.0);
+  return date;
+}
+
+bool isValidDate(DateTime const& date, Calendar calendar) {
+  return date.month >= 1 and date.month <= 12 and date.day >= 1 and
+         date.day <= daysInMonth(date.year, date.month, calendar);
+}
+
+TimeAxis::TimeAxis(std::vector<double> values, std::string const& units,
+                   std::string const& calendar)
+    : values_{std::move(values)} {
+  // find needs strictly ascending values without NaN; an axis that has
+  // anything else is left empty, so only t indices work
+  auto ascending = std::adjacent_find(values_.begin(), values_.end(),
+                                      [](double a, double b) {
+                                        return not(a < b);
+                                      }) == values_.end();
+  if (not ascending or
+      std::any_of(values_.begin(), values_.end(),
+                  [](double v) { return std::isnan(v); })) {
+    values_.clear();
+    return;
+  }
+
+  // "<unit> since <date>"; anything else leaves the axis without dates
+  auto lower = units;
+  for (auto& c : lower) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  auto since = lower.find(" since ");
+  auto parsed_calendar = parseCalendar(calendar);
+  if (since == std::string::npos or not parsed_calendar) {
+    return;
+  }
+  auto unit_seconds =
+      unitSeconds(trim(std::string_view{lower}.substr(0, since)));
+  auto reference = parseDateTime(std::string_view{units}.substr(since + 7));
+  if (unit_seconds == 0.0 or not reference or
+      not isValidDate(*reference, *parsed_calendar)) {
+    return;
+  }
+  calendar_ = *parsed_calendar;
+  seconds_per_unit_ = unit_seconds;
+  reference_seconds_ =
+      dayNumber(*reference, calendar_) * kSecondsPerDay + reference->seconds;
+}
+
+std::optional<double> TimeAxis::valueOf(DateTime const& date) const {
+  if (not hasDates() or not isValidDate(date, calendar_)) {
+    return std::nullopt;
+  }
+  auto seconds = dayNumber(date, calendar_) * kSecondsPerDay + date.seconds;
+  return (seconds - reference_seconds_) / seconds_per_unit_;
+}
+
+std::optional<std::size_t> TimeAxis::find(double value) const {
+  // also rejects NaN
+  if (values_.empty() or
+      not(value >= values_.front() and value <= values_.back())) {
+    return std::nullopt;
+  }
+  auto after = std::lower_bound(values_.begin(), values_.end(), value);
+  auto index = static_cast<std::size_t>(after - values_.begin());
+  if (index > 0 and value - values_[index - 1] < *after - value) {
+    --index;
+  }
+  return index;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Calendars of the CF conventions. "standard" and "gregorian" are treated as
+// proleptic Gregorian, which only differs from them before 1582.
+enum class Calendar { Standard, NoLeap, AllLeap, Day360 };
+
+// Parses a CF calendar name; returns std::nullopt for unsupported ones.
+std::optional<Calendar> parseCalendar(std::string_view name);
+
+// A calendar date and the time of day in seconds.
+struct DateTime {
+  int year;
+  int month;
+  int day;
+  double seconds = 0.0;
+};
+
+// Parses an ISO 8601 style date, "YYYY-MM-DD", optionally followed by 'T' or a
+// space and "hh:mm[:ss[.fff]]", and an optional "Z" or "+hh:mm" offset, which
+// is folded into the time. Fields may have fewer digits, as they often do in
+// CF units. Returns std::nullopt if the text is not such a date. Month
+// lengths depend on the calendar, so the day is checked by isValidDate.
+std::optional<DateTime> parseDateTime(std::string_view text);
+
+// Whether the date exists in the calendar (e.g. February 30 in 360_day).
+bool isValidDate(DateTime const& date, Calendar calendar);
+
+// The time coordinate of the file, read once when the file is opened. Values
+// are in the units of the "time" variable and must be strictly ascending;
+// otherwise the axis is left empty and has no dates. When the units are CF
+// units, "<unit> since <date>", and the calendar is supported, dates can be
+// converted into time values as well.
+class TimeAxis {
+ public:
+  TimeAxis() = default;
+  TimeAxis(std::vector<double> values, std::string const& units,
+           std::string const& calendar);
+
+  std::vector<double> const& values() const { return values_; }
+  bool hasDates() const { return seconds_per_unit_ > 0.0; }
+
+  // Returns the time value of a date, or std::nullopt if the axis has no
+  // dates or the date does not exist in its calendar.
+  std::optional<double> valueOf(DateTime const& date) const;
+
+  // Finds the time step nearest to a time value by binary search over the
+  // values. Returns std::nullopt if it lies outside them.
+  std::optional<std::size_t> find(double value) const;
+
+ private:
+  std::vector<double> values_;
+  Calendar calendar_ = Calendar::Standard;
+  double seconds_per_unit_ = 0.0;  // zero if the units are not decodable
+  double reference_seconds_ = 0.0;  // of the "since" date, in the calendar
+};